@@ -0,0 +1,601 @@
+// Microbenchmarks for the per-request work in main.cpp: SQLite statement
+// preparation, building and dumping the JSON of /movies and /showtimes,
+// parsing Auditoriums.Layout and seat identifiers, and generating tokens.
+// The bookings/ cases compare the old one-row-per-seat Bookings table with
+// BookingHeaders/BookingSeats for loading a showtime's occupancy and for
+// committing a booking.
+// Each case runs until --min-time has passed, --repetitions times, and the
+// results go to stdout (or --out) as JSON so runs can be compared between
+// releases. Progress goes to stderr.
+//
+// Build (from bmsv3_backend):
+//     g++ -std=c++17 -O2 bench.cpp -o bench -I include -lsqlite3
+// Run:
+//     ./bench --out bench.json [--filter json/] [--min-time 0.2] [--repetitions 3]
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "include/json.hpp"
+#include "seat_layout.hpp"
+#include "seat_map.hpp"
+#include "session_token.hpp"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from dropping work whose result is unused.
+template <class T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchOptions
+{
+    std::string filter;
+    std::string out;
+    double min_time = 0.2; // seconds per repetition
+    int repetitions = 3;
+};
+
+struct BenchResult
+{
+    std::string name;
+    long iterations = 0; // per repetition
+    std::vector<double> ns_per_op;
+};
+
+class BenchRunner
+{
+public:
+    explicit BenchRunner(const BenchOptions& options) : options_(options) {}
+
+    // `body(n)` runs the measured operation n times.
+    void run(const std::string& name, const std::function<void(long)>& body)
+    {
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) return;
+        BenchResult result;
+        result.name = name;
+
+        // Grow the batch until one run takes a tenth of min_time, then size the
+        // repetitions from that.
+        long n = 1;
+        double seconds = 0;
+        for (;;) {
+            seconds = time(body, n);
+            if (seconds >= options_.min_time / 10 || n >= (1L << 30)) break;
+            n *= 10;
+        }
+        result.iterations = std::max(1L, static_cast<long>(n * options_.min_time / std::max(seconds, 1e-9)));
+        for (int r = 0; r < options_.repetitions; ++r) {
+            result.ns_per_op.push_back(time(body, result.iterations) * 1e9 / result.iterations);
+        }
+        std::sort(result.ns_per_op.begin(), result.ns_per_op.end());
+        std::cerr << name << ": " << median(result) << " ns/op" << std::endl;
+        results_.push_back(std::move(result));
+    }
+
+    json report() const
+    {
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        json j;
+        j["context"] = {
+            {"date", date},
+            {"compiler", __VERSION__},
+            {"sqlite_version", sqlite3_libversion()},
+#ifdef NDEBUG
+            {"assertions", false},
+#else
+            {"assertions", true},
+#endif
+            {"min_time_s", options_.min_time},
+            {"repetitions", options_.repetitions},
+        };
+        j["benchmarks"] = json::array();
+        for (const auto& result : results_) {
+            j["benchmarks"].push_back({
+                {"name", result.name},
+                {"iterations", result.iterations},
+                {"ns_per_op", median(result)},
+                {"min_ns_per_op", result.ns_per_op.front()},
+                {"max_ns_per_op", result.ns_per_op.back()},
+            });
+        }
+        return j;
+    }
+
+private:
+    static double time(const std::function<void(long)>& body, long n)
+    {
+        auto started = Clock::now();
+        body(n);
+        return std::chrono::duration<double>(Clock::now() - started).count();
+    }
+
+    static double median(const BenchResult& result) { return result.ns_per_op[result.ns_per_op.size() / 2]; }
+
+    BenchOptions options_;
+    std::vector<BenchResult> results_;
+};
+
+// --- Synthetic data, shaped like the seeded database ---
+
+const char* LAYOUT_JSON = "{\"sections\":[8, 12, 8], \"premium_rows\":2, \"total_rows\":10}";
+
+struct MovieRow
+{
+    int id;
+    std::string title, poster_url, synopsis, rating;
+    int duration;
+};
+
+struct ShowtimeRow
+{
+    int venue_id;
+    std::string venue_name;
+    double venue_rating;
+    std::string venue_image_url, time;
+    int showtime_id, auditorium_id, seats_remaining, premium_remaining;
+};
+
+std::vector<MovieRow> movie_rows(int count)
+{
+    std::vector<MovieRow> rows;
+    for (int i = 1; i <= count; ++i) {
+        rows.push_back({i, "Movie number " + std::to_string(i), "images/posters/movie" + std::to_string(i) + ".jpg",
+                        std::string(300, 's'), "UA", 100 + i});
+    }
+    return rows;
+}
+
+// One movie's showtimes for one day: `venues` venues, `per_venue` times each.
+std::vector<ShowtimeRow> showtime_rows(int venues, int per_venue)
+{
+    std::vector<ShowtimeRow> rows;
+    int id = 1;
+    for (int v = 1; v <= venues; ++v) {
+        for (int t = 0; t < per_venue; ++t) {
+            char time[16];
+            std::snprintf(time, sizeof(time), "%02d:%02d", 10 + t * 3, 30);
+            rows.push_back({v, "Venue " + std::to_string(v), 4.5, "images/venues/venue" + std::to_string(v) + ".jpg", time, id++, 1, 150, 40});
+        }
+    }
+    return rows;
+}
+
+// An in-memory database with the tables /showtimes and the session lookup read.
+sqlite3* open_bench_db(int movies, int venues, int days, int per_venue)
+{
+    sqlite3* db;
+    sqlite3_open(":memory:", &db);
+    sqlite3_exec(db,
+                 "CREATE TABLE Venues (VenueID INTEGER PRIMARY KEY, Name TEXT, Rating REAL, ImageURL TEXT);"
+                 "CREATE TABLE Showtimes (ShowtimeID INTEGER PRIMARY KEY, MovieID INTEGER, VenueID INTEGER, AuditoriumID INTEGER,"
+                 " ShowtimeDateTime TEXT NOT NULL, SeatsRemaining INTEGER, PremiumRemaining INTEGER);"
+                 "CREATE INDEX idx_showtimes_movie_time ON Showtimes(MovieID, ShowtimeDateTime);"
+                 "CREATE TABLE Users (UserID INTEGER PRIMARY KEY, Username TEXT, SessionToken TEXT);"
+                 "CREATE INDEX idx_users_session_token ON Users(SessionToken);",
+                 nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO Venues VALUES (?, ?, 4.5, ?)", -1, &stmt, 0);
+    for (int v = 1; v <= venues; ++v) {
+        std::string name = "Venue " + std::to_string(v), image = "images/venues/venue" + std::to_string(v) + ".jpg";
+        sqlite3_bind_int(stmt, 1, v);
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, image.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_prepare_v2(db, "INSERT INTO Showtimes (MovieID, VenueID, AuditoriumID, ShowtimeDateTime, SeatsRemaining, PremiumRemaining) "
+                           "VALUES (?, ?, 1, ?, 150, 40)", -1, &stmt, 0);
+    for (int m = 1; m <= movies; ++m) {
+        for (int d = 0; d < days; ++d) {
+            for (int v = 1; v <= venues; ++v) {
+                for (int t = 0; t < per_venue; ++t) {
+                    char when[48];
+                    std::snprintf(when, sizeof(when), "2025-08-%02d %02d:30:00", 1 + d, 10 + t * 3);
+                    sqlite3_bind_int(stmt, 1, m);
+                    sqlite3_bind_int(stmt, 2, v);
+                    sqlite3_bind_text(stmt, 3, when, -1, SQLITE_TRANSIENT);
+                    sqlite3_step(stmt);
+                    sqlite3_reset(stmt);
+                }
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_prepare_v2(db, "INSERT INTO Users (Username, SessionToken) VALUES (?, ?)", -1, &stmt, 0);
+    for (int u = 1; u <= 1000; ++u) {
+        std::string name = "user" + std::to_string(u), token = "token" + std::to_string(u);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, token.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    return db;
+}
+
+// The /showtimes query, as main.cpp runs it.
+const char* SHOWTIMES_SQL =
+    "SELECT V.VenueID, V.Name, V.Rating, V.ImageURL, strftime('%H:%M', S.ShowtimeDateTime), S.ShowtimeID, S.AuditoriumID, "
+    "S.SeatsRemaining, S.PremiumRemaining "
+    "FROM Showtimes AS S JOIN Venues AS V ON S.VenueID = V.VenueID "
+    "WHERE S.MovieID = ? AND S.ShowtimeDateTime >= ? AND S.ShowtimeDateTime < date(?, '+1 day') "
+    "ORDER BY V.VenueID, S.ShowtimeDateTime";
+
+// The session lookup behind every authenticated request.
+const char* SESSION_SQL = "SELECT UserID FROM Users WHERE SessionToken = ?";
+
+long step_showtimes(sqlite3_stmt* stmt)
+{
+    sqlite3_bind_int(stmt, 1, 3);
+    sqlite3_bind_text(stmt, 2, "2025-08-05", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, "2025-08-05", -1, SQLITE_STATIC);
+    long sum = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) sum += sqlite3_column_int(stmt, 5);
+    return sum;
+}
+
+long step_session(sqlite3_stmt* stmt)
+{
+    sqlite3_bind_text(stmt, 1, "token500", -1, SQLITE_STATIC);
+    return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+}
+
+// Same DOM shape and insertion pattern as the /movies handler.
+json build_movies(const std::vector<MovieRow>& rows)
+{
+    json movies_json = json::array();
+    for (const auto& row : rows) {
+        json movie;
+        movie["id"] = row.id;
+        movie["title"] = row.title;
+        movie["poster_url"] = row.poster_url;
+        movie["synopsis"] = row.synopsis;
+        movie["duration_minutes"] = row.duration;
+        movie["rating"] = row.rating;
+        movies_json.push_back(movie);
+    }
+    return movies_json;
+}
+
+// Same DOM shape and insertion pattern as the /showtimes handler.
+json build_showtimes(const std::vector<ShowtimeRow>& rows)
+{
+    json venues_with_showtimes = json::object();
+    for (const auto& row : rows) {
+        std::string venue_id_key = std::to_string(row.venue_id);
+        if (venues_with_showtimes.find(venue_id_key) == venues_with_showtimes.end()) {
+            venues_with_showtimes[venue_id_key]["venue_id"] = row.venue_id;
+            venues_with_showtimes[venue_id_key]["venue_name"] = row.venue_name;
+            venues_with_showtimes[venue_id_key]["venue_rating"] = row.venue_rating;
+            venues_with_showtimes[venue_id_key]["venue_image_url"] = row.venue_image_url;
+            venues_with_showtimes[venue_id_key]["showtimes"] = json::array();
+        }
+        json showtime_obj;
+        showtime_obj["time"] = row.time;
+        showtime_obj["showtime_id"] = row.showtime_id;
+        showtime_obj["auditorium_id"] = row.auditorium_id;
+        showtime_obj["seats_remaining"] = row.seats_remaining;
+        showtime_obj["premium_remaining"] = row.premium_remaining;
+        showtime_obj["sold_out"] = row.seats_remaining <= 0;
+        venues_with_showtimes[venue_id_key]["showtimes"].push_back(showtime_obj);
+    }
+    json final_response = json::array();
+    for (auto& el : venues_with_showtimes.items()) final_response.push_back(el.value());
+    return final_response;
+}
+
+// Reference point for generate_session_token: one engine per thread, seeded
+// once, and a hex table instead of a stringstream.
+std::string token_from_thread_engine()
+{
+    static const char hex[] = "0123456789abcdef";
+    thread_local std::mt19937_64 gen(std::random_device{}());
+    std::string token(64, '0');
+    for (int i = 0; i < 64; i += 16) {
+        uint64_t bits = gen();
+        for (int k = 0; k < 16; ++k, bits >>= 4) token[i + k] = hex[bits & 15];
+    }
+    return token;
+}
+
+// --- Bookings: the old per-seat rowid table against BookingHeaders/BookingSeats ---
+
+const int BOOKED_SHOWTIMES = 2000;
+
+// `showtimes` showtimes of the LAYOUT_JSON auditorium with every other seat
+// booked, four seats per booking. Bookings go round the showtimes in turn,
+// the way sales for many shows interleave, so in the old table one
+// showtime's rows end up spread over the whole file.
+sqlite3* open_bookings_db(bool clustered, int showtimes)
+{
+    sqlite3* db;
+    sqlite3_open(":memory:", &db);
+    if (clustered) {
+        sqlite3_exec(db,
+                     "CREATE TABLE BookingHeaders (OrderID INTEGER PRIMARY KEY AUTOINCREMENT, ShowtimeID INTEGER NOT NULL,"
+                     " UserID INTEGER, CreatedAt TEXT DEFAULT CURRENT_TIMESTAMP);"
+                     "CREATE TABLE BookingSeats (ShowtimeID INTEGER NOT NULL, SeatIndex INTEGER NOT NULL, OrderID INTEGER NOT NULL,"
+                     " PRIMARY KEY (ShowtimeID, SeatIndex)) WITHOUT ROWID;"
+                     "CREATE INDEX idx_booking_headers_user ON BookingHeaders(UserID, OrderID DESC);"
+                     "CREATE INDEX idx_booking_seats_order ON BookingSeats(OrderID);",
+                     nullptr, nullptr, nullptr);
+    } else {
+        sqlite3_exec(db,
+                     "CREATE TABLE Bookings (BookingID INTEGER PRIMARY KEY AUTOINCREMENT, ShowtimeID INTEGER, UserID INTEGER,"
+                     " SeatIdentifier TEXT NOT NULL, OrderID INTEGER);"
+                     "CREATE UNIQUE INDEX idx_bookings_showtime_seat ON Bookings(ShowtimeID, SeatIdentifier);"
+                     "CREATE INDEX idx_bookings_user_order ON Bookings(UserID, OrderID DESC, ShowtimeID, SeatIdentifier);",
+                     nullptr, nullptr, nullptr);
+    }
+
+    SeatLayout layout = parse_seat_layout(LAYOUT_JSON);
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt* header;
+    sqlite3_stmt* seat;
+    if (clustered) {
+        sqlite3_prepare_v2(db, "INSERT INTO BookingHeaders (OrderID, ShowtimeID, UserID) VALUES (?, ?, ?)", -1, &header, 0);
+        sqlite3_prepare_v2(db, "INSERT INTO BookingSeats (ShowtimeID, SeatIndex, OrderID) VALUES (?, ?, ?)", -1, &seat, 0);
+    } else {
+        header = nullptr;
+        sqlite3_prepare_v2(db, "INSERT INTO Bookings (ShowtimeID, UserID, SeatIdentifier, OrderID) VALUES (?, ?, ?, ?)", -1, &seat, 0);
+    }
+    long order_id = 0;
+    for (int first = 0; first < layout.seat_count(); first += 8) {
+        for (int showtime = 1; showtime <= showtimes; ++showtime) {
+            ++order_id;
+            int user = static_cast<int>(order_id % 1000) + 1;
+            if (header) {
+                sqlite3_bind_int64(header, 1, order_id);
+                sqlite3_bind_int(header, 2, showtime);
+                sqlite3_bind_int(header, 3, user);
+                sqlite3_step(header);
+                sqlite3_reset(header);
+            }
+            for (int index = first; index < first + 8 && index < layout.seat_count(); index += 2) {
+                sqlite3_bind_int(seat, 1, showtime);
+                if (clustered) {
+                    sqlite3_bind_int(seat, 2, index);
+                    sqlite3_bind_int64(seat, 3, order_id);
+                } else {
+                    std::string id = seat_identifier(layout, index);
+                    sqlite3_bind_int(seat, 2, user);
+                    sqlite3_bind_text(seat, 3, id.c_str(), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_int64(seat, 4, order_id);
+                }
+                sqlite3_step(seat);
+                sqlite3_reset(seat);
+            }
+        }
+    }
+    sqlite3_finalize(header);
+    sqlite3_finalize(seat);
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    return db;
+}
+
+// What load_showtime_seats does with each schema, minus the layout lookup.
+long load_occupancy(sqlite3_stmt* stmt, int showtime_id, const SeatLayout& layout, bool clustered)
+{
+    ShowtimeSeats seats(layout);
+    long booked = 0;
+    sqlite3_bind_int(stmt, 1, showtime_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int index = clustered ? sqlite3_column_int(stmt, 0)
+                              : seats.seat_index(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        if (index < 0) continue;
+        seats.set_booked(index, true);
+        ++booked;
+    }
+    sqlite3_reset(stmt);
+    return booked;
+}
+
+// One committed four-seat booking of an otherwise empty showtime, written the
+// way book_seats writes it with each schema (the old one inserted the first
+// seat, then set the OrderID of all four from its BookingID).
+void book_four_seats(sqlite3* db, bool clustered, int showtime_id, const SeatLayout& layout)
+{
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    sqlite3_int64 order_id = 0;
+    if (clustered) {
+        sqlite3_prepare_v2(db, "INSERT INTO BookingHeaders (ShowtimeID, UserID) VALUES (?, 7)", -1, &stmt, 0);
+        sqlite3_bind_int(stmt, 1, showtime_id);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        order_id = sqlite3_last_insert_rowid(db);
+        sqlite3_prepare_v2(db, "INSERT INTO BookingSeats (ShowtimeID, SeatIndex, OrderID) VALUES (?, ?, ?)", -1, &stmt, 0);
+        for (int index = 0; index < 4; ++index) {
+            sqlite3_bind_int(stmt, 1, showtime_id);
+            sqlite3_bind_int(stmt, 2, index);
+            sqlite3_bind_int64(stmt, 3, order_id);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    } else {
+        for (int index = 0; index < 4; ++index) {
+            std::string id = seat_identifier(layout, index);
+            sqlite3_prepare_v2(db, "INSERT INTO Bookings (ShowtimeID, UserID, SeatIdentifier, OrderID) VALUES (?, 7, ?, ?)", -1, &stmt, 0);
+            sqlite3_bind_int(stmt, 1, showtime_id);
+            sqlite3_bind_text(stmt, 2, id.c_str(), -1, SQLITE_TRANSIENT);
+            if (order_id) sqlite3_bind_int64(stmt, 3, order_id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+            if (!order_id) {
+                order_id = sqlite3_last_insert_rowid(db);
+                sqlite3_prepare_v2(db, "UPDATE Bookings SET OrderID = BookingID WHERE BookingID = ?", -1, &stmt, 0);
+                sqlite3_bind_int64(stmt, 1, order_id);
+                sqlite3_step(stmt);
+                sqlite3_finalize(stmt);
+            }
+        }
+    }
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+}
+
+bool parse_options(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--filter") options.filter = value;
+            else if (arg == "--out") options.out = value;
+            else if (arg == "--min-time") options.min_time = std::stod(value);
+            else if (arg == "--repetitions") options.repetitions = std::stoi(value);
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return options.min_time > 0 && options.repetitions > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) return 2;
+    BenchRunner bench(options);
+
+    // SQLite: a fresh statement per request (what every handler does today)
+    // against one prepared once and reset between uses.
+    sqlite3* db = open_bench_db(20, 30, 14, 4);
+    bench.run("sqlite/showtimes_query/prepare_each", [db](long n) {
+        for (long i = 0; i < n; ++i) {
+            sqlite3_stmt* stmt;
+            sqlite3_prepare_v2(db, SHOWTIMES_SQL, -1, &stmt, 0);
+            keep(step_showtimes(stmt));
+            sqlite3_finalize(stmt);
+        }
+    });
+    bench.run("sqlite/showtimes_query/cached", [db](long n) {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, SHOWTIMES_SQL, -1, &stmt, 0);
+        for (long i = 0; i < n; ++i) {
+            keep(step_showtimes(stmt));
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    });
+    bench.run("sqlite/session_lookup/prepare_each", [db](long n) {
+        for (long i = 0; i < n; ++i) {
+            sqlite3_stmt* stmt;
+            sqlite3_prepare_v2(db, SESSION_SQL, -1, &stmt, 0);
+            keep(step_session(stmt));
+            sqlite3_finalize(stmt);
+        }
+    });
+    bench.run("sqlite/session_lookup/cached", [db](long n) {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, SESSION_SQL, -1, &stmt, 0);
+        for (long i = 0; i < n; ++i) {
+            keep(step_session(stmt));
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    });
+    sqlite3_close(db);
+
+    // JSON: the DOM each handler builds and the dump() that serializes it.
+    auto movies = movie_rows(20);
+    auto showtimes = showtime_rows(30, 4);
+    bench.run("json/movies/build", [&](long n) {
+        for (long i = 0; i < n; ++i) keep(build_movies(movies).size());
+    });
+    json movies_dom = build_movies(movies);
+    bench.run("json/movies/dump", [&](long n) {
+        for (long i = 0; i < n; ++i) keep(movies_dom.dump().size());
+    });
+    bench.run("json/showtimes/build", [&](long n) {
+        for (long i = 0; i < n; ++i) keep(build_showtimes(showtimes).size());
+    });
+    json showtimes_dom = build_showtimes(showtimes);
+    bench.run("json/showtimes/dump", [&](long n) {
+        for (long i = 0; i < n; ++i) keep(showtimes_dom.dump().size());
+    });
+
+    // Seat layouts and identifiers, as parsed for every booking.
+    bench.run("layout/parse_seat_layout", [](long n) {
+        for (long i = 0; i < n; ++i) keep(parse_seat_layout(LAYOUT_JSON).total_rows);
+    });
+    SeatLayout layout = parse_seat_layout(LAYOUT_JSON);
+    ShowtimeSeats seats(layout);
+    std::vector<std::string> identifiers;
+    for (int i = 0; i < layout.seat_count(); ++i) identifiers.push_back(seats.seat_identifier(i));
+    bench.run("seats/parse_seat_identifier", [&](long n) {
+        int row, seat_number;
+        for (long i = 0; i < n; ++i) keep(parse_seat_identifier(layout, identifiers[i % identifiers.size()], row, seat_number));
+    });
+    bench.run("seats/seat_identifier", [&](long n) {
+        for (long i = 0; i < n; ++i) keep(seats.seat_identifier(static_cast<int>(i % identifiers.size())).size());
+    });
+
+    // Bookings: reading one showtime's occupancy, and committing a booking.
+    for (bool clustered : {false, true}) {
+        std::string schema = clustered ? "booking_seats" : "legacy";
+        if (!options.filter.empty() && ("bookings/occupancy_read/" + schema).find(options.filter) == std::string::npos &&
+            ("bookings/book_4_seats/" + schema).find(options.filter) == std::string::npos)
+            continue;
+        sqlite3* bookings_db = open_bookings_db(clustered, BOOKED_SHOWTIMES);
+        sqlite3_stmt* occupancy;
+        sqlite3_prepare_v2(bookings_db, clustered ? "SELECT SeatIndex FROM BookingSeats WHERE ShowtimeID = ?"
+                                                  : "SELECT SeatIdentifier FROM Bookings WHERE ShowtimeID = ?",
+                           -1, &occupancy, 0);
+        bench.run("bookings/occupancy_read/" + schema, [&](long n) {
+            for (long i = 0; i < n; ++i) keep(load_occupancy(occupancy, static_cast<int>(i % BOOKED_SHOWTIMES) + 1, layout, clustered));
+        });
+        sqlite3_finalize(occupancy);
+        int next_showtime = BOOKED_SHOWTIMES + 1;
+        bench.run("bookings/book_4_seats/" + schema, [&](long n) {
+            for (long i = 0; i < n; ++i) book_four_seats(bookings_db, clustered, next_showtime++, layout);
+        });
+        sqlite3_close(bookings_db);
+    }
+
+    // Tokens for logins, holds and waitlist entries.
+    bench.run("token/generate_session_token", [](long n) {
+        for (long i = 0; i < n; ++i) keep(generate_session_token().size());
+    });
+    bench.run("token/thread_local_engine", [](long n) {
+        for (long i = 0; i < n; ++i) keep(token_from_thread_engine().size());
+    });
+
+    std::string report = bench.report().dump(2);
+    if (options.out.empty()) {
+        std::cout << report << std::endl;
+    } else {
+        std::ofstream out(options.out);
+        out << report << std::endl;
+        if (!out) {
+            std::cerr << "Could not write " << options.out << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
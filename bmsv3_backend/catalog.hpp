@@ -0,0 +1,38 @@
+#pragma once
+
+// Movies and venues change only when the database is re-seeded, so handlers
+// that just need a title or a venue name look them up in this snapshot
+// instead of joining against Movies/Venues on every query.
+
+#include <string>
+#include <unordered_map>
+#include "geo_index.hpp"
+#include "schedule.hpp"
+
+struct MovieSummary
+{
+    int movie_id;
+    std::string title;
+    std::string poster_url;
+    int duration_minutes;
+    std::string rating;
+};
+
+struct Catalog
+{
+    std::unordered_map<int, MovieSummary> movies;
+    std::unordered_map<int, VenueSummary> venues;
+    GeoGrid venue_grid; // venues that have coordinates, by VenueID
+
+    const MovieSummary* movie(int id) const
+    {
+        auto it = movies.find(id);
+        return it == movies.end() ? nullptr : &it->second;
+    }
+
+    const VenueSummary* venue(int id) const
+    {
+        auto it = venues.find(id);
+        return it == venues.end() ? nullptr : &it->second;
+    }
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+// Runs SQLite work on a dedicated pool of DB threads so Crow's I/O threads
+// never wait on sqlite3_step. Each DB thread opens its own connection the
+// first time it runs a job (WAL mode lets them read while the inventory
+// shards write).
+//
+// Jobs come in priority classes, each with its own bounded queue, and a free
+// DB thread always takes the oldest job of the highest class waiting, so a
+// burst of browsing can't hold up checkout. A class sheds load CoDel-style:
+// as long as its queue drains now and then, a job may wait up to the class's
+// deadline, but once no job has got through within the target wait for a
+// whole interval (a standing queue), jobs that waited longer than the target
+// are dropped unrun. Dropped and refused jobs are answered 503 by the caller.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+#include "log.hpp"
+#include "metrics.hpp"
+#include "slow_query_log.hpp"
+#include "tracing.hpp"
+
+// Highest first.
+enum class DbPriority
+{
+    Checkout, // booking, cancelling, joining a waitlist
+    Account,  // signing up, logging in, booking history
+    Browse,   // movies, venues, showtimes, seat layouts
+};
+
+constexpr size_t DB_PRIORITY_COUNT = 3;
+
+inline const char* db_priority_name(DbPriority priority)
+{
+    switch (priority) {
+    case DbPriority::Checkout: return "checkout";
+    case DbPriority::Account: return "account";
+    case DbPriority::Browse: return "browse";
+    }
+    return "browse";
+}
+
+struct DbQueueLimits
+{
+    size_t max_queued;
+    std::chrono::milliseconds target;   // standing-queue wait to shed above; 0 never sheds on it
+    std::chrono::milliseconds deadline; // longest any job may wait
+};
+
+class DbExecutor
+{
+public:
+    // How long waits must stay above the target before the class sheds.
+    static constexpr auto CODEL_INTERVAL = std::chrono::milliseconds(100);
+
+    DbExecutor(size_t threads, const std::array<DbQueueLimits, DB_PRIORITY_COUNT>& limits, std::string db_path)
+        : db_path_(std::move(db_path)),
+          exec_(metrics().histogram("db_job_seconds", "Time a DB thread spent running a job"))
+    {
+        for (size_t i = 0; i < DB_PRIORITY_COUNT; ++i) {
+            std::string labels = std::string("class=\"") + db_priority_name(static_cast<DbPriority>(i)) + "\"";
+            classes_[i].limits = limits[i];
+            classes_[i].depth = &metrics().gauge("db_queue_depth", "Jobs waiting for a DB thread", labels);
+            classes_[i].wait = &metrics().histogram("db_queue_wait_seconds", "Time a job spent queued before a DB thread picked it up", labels);
+            classes_[i].rejected = &metrics().counter("db_jobs_rejected_total", "Jobs refused because their class's DB queue was full", labels);
+            classes_[i].shed_overload = &metrics().counter("db_jobs_shed_total", "Queued jobs dropped unrun",
+                                                           labels + ",reason=\"overload\"");
+            classes_[i].shed_deadline = &metrics().counter("db_jobs_shed_total", "Queued jobs dropped unrun",
+                                                           labels + ",reason=\"deadline\"");
+        }
+        for (size_t i = 0; i < threads; ++i) threads_.emplace_back([this] { run(); });
+    }
+
+    // Runs what is still queued, then stops the threads.
+    ~DbExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) thread.join();
+    }
+
+    // Queues job(conn) for a DB thread. Returns false without queuing when the
+    // class's queue is full; the caller should answer 503 rather than wait.
+    // If the job is later dropped unrun, `shed` is called instead (on a DB
+    // thread) and should answer 503 too.
+    bool submit(DbPriority priority, std::function<void(sqlite3*)> job, std::function<void()> shed)
+    {
+        Class& c = classes_[static_cast<size_t>(priority)];
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (c.queue.size() >= c.limits.max_queued) {
+                c.rejected->inc();
+                return false;
+            }
+            c.queue.push_back({std::move(job), std::move(shed), std::chrono::steady_clock::now(), current_trace()});
+            c.depth->add(1);
+        }
+        wake_.notify_one();
+        return true;
+    }
+
+private:
+    struct Job
+    {
+        std::function<void(sqlite3*)> run;
+        std::function<void()> shed;
+        std::chrono::steady_clock::time_point queued_at;
+        uint64_t trace;
+    };
+
+    struct Class
+    {
+        DbQueueLimits limits{};
+        std::deque<Job> queue;
+        // Set while waits have stayed above the target; shedding starts once
+        // it is a whole interval in the past.
+        std::chrono::steady_clock::time_point above_target_since{};
+        bool above_target = false;
+        Gauge* depth = nullptr;
+        Histogram* wait = nullptr;
+        Counter* rejected = nullptr;
+        Counter* shed_overload = nullptr;
+        Counter* shed_deadline = nullptr;
+    };
+
+    // Called under mutex_ with the job just taken off c's queue.
+    static Counter* shed_reason(Class& c, std::chrono::steady_clock::duration waited, std::chrono::steady_clock::time_point now)
+    {
+        if (waited > c.limits.deadline) return c.shed_deadline;
+        if (c.limits.target.count() == 0) return nullptr;
+        if (waited <= c.limits.target || c.queue.empty()) {
+            c.above_target = false;
+            return nullptr;
+        }
+        if (!c.above_target) {
+            c.above_target = true;
+            c.above_target_since = now;
+            return nullptr;
+        }
+        return now - c.above_target_since >= CODEL_INTERVAL ? c.shed_overload : nullptr;
+    }
+
+    void run()
+    {
+        while (true) {
+            Job job;
+            Class* from = nullptr;
+            Counter* shed = nullptr;
+            std::chrono::steady_clock::time_point started;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || has_work(); });
+                if (!has_work()) return; // stopping
+                for (auto& c : classes_) {
+                    if (c.queue.empty()) continue;
+                    from = &c;
+                    break;
+                }
+                job = std::move(from->queue.front());
+                from->queue.pop_front();
+                started = std::chrono::steady_clock::now();
+                shed = shed_reason(*from, started - job.queued_at, started);
+                from->depth->add(-1);
+            }
+            from->wait->observe(std::chrono::duration<double>(started - job.queued_at).count());
+
+            TraceScope scope(job.trace);
+            trace_thread_name("db");
+            trace_record("db.queue", "db", Tracer::to_us(job.queued_at), Tracer::to_us(started));
+            if (shed) {
+                shed->inc();
+                if (job.shed) job.shed();
+                continue;
+            }
+            TraceSpan span("db.job", "db");
+            try {
+                job.run(connection());
+            } catch (const std::exception& e) {
+                log_error("DB job failed", {{"error", e.what()}});
+            }
+            exec_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        }
+    }
+
+    bool has_work() const
+    {
+        for (const auto& c : classes_) {
+            if (!c.queue.empty()) return true;
+        }
+        return false;
+    }
+
+    sqlite3* connection()
+    {
+        struct Connection
+        {
+            sqlite3* db = nullptr;
+            ~Connection() { if (db) sqlite3_close(db); }
+        };
+        thread_local Connection conn;
+        if (!conn.db) {
+            if (sqlite3_open(db_path_.c_str(), &conn.db) != SQLITE_OK) {
+                log_error("DB thread can't open database", {{"path", db_path_}, {"error", sqlite3_errmsg(conn.db)}});
+            }
+            sqlite3_busy_timeout(conn.db, 5000);
+            watch_statements(conn.db);
+        }
+        return conn.db;
+    }
+
+    std::string db_path_;
+    Histogram& exec_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::array<Class, DB_PRIORITY_COUNT> classes_;
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+// Fixed-size lat/lon grid over points (venues). A radius query only looks at
+// the cells overlapping the circle's bounding box, so its cost depends on how
+// many venues are nearby rather than how many exist.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct GeoMatch
+{
+    int id;
+    double distance_km;
+};
+
+inline double haversine_km(double lat1, double lon1, double lat2, double lon2)
+{
+    const double to_rad = 3.14159265358979323846 / 180.0;
+    double dlat = (lat2 - lat1) * to_rad;
+    double dlon = (lon2 - lon1) * to_rad;
+    double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+               std::cos(lat1 * to_rad) * std::cos(lat2 * to_rad) * std::sin(dlon / 2) * std::sin(dlon / 2);
+    return 2 * 6371.0 * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+class GeoGrid
+{
+public:
+    // 0.1 degree cells are about 11 km tall.
+    explicit GeoGrid(double cell_degrees = 0.1) : cell_(cell_degrees), lon_cells_(static_cast<int>(std::ceil(360.0 / cell_degrees))) {}
+
+    void insert(int id, double lat, double lon)
+    {
+        points_.push_back({id, lat, lon});
+        cells_[key(lat_cell(lat), lon_cell(lon))].push_back(points_.size() - 1);
+    }
+
+    size_t size() const { return points_.size(); }
+
+    // Up to `limit` points within radius_km of (lat, lon), nearest first.
+    std::vector<GeoMatch> within(double lat, double lon, double radius_km, size_t limit) const
+    {
+        std::vector<GeoMatch> matches;
+        const double km_per_degree = 111.32;
+        double lat_span = radius_km / km_per_degree;
+        double cos_lat = std::cos(std::min(89.0, std::fabs(lat)) * 3.14159265358979323846 / 180.0);
+        double lon_span = std::min(180.0, radius_km / (km_per_degree * cos_lat));
+
+        int lat_lo = lat_cell(std::max(-90.0, lat - lat_span));
+        int lat_hi = lat_cell(std::min(90.0, lat + lat_span));
+        int lon_lo = static_cast<int>(std::floor((lon - lon_span) / cell_));
+        int lon_hi = static_cast<int>(std::floor((lon + lon_span) / cell_));
+        if (lon_hi - lon_lo >= lon_cells_) lon_hi = lon_lo + lon_cells_ - 1;
+
+        for (int la = lat_lo; la <= lat_hi; ++la) {
+            for (int lo = lon_lo; lo <= lon_hi; ++lo) {
+                auto cell = cells_.find(key(la, wrap(lo)));
+                if (cell == cells_.end()) continue;
+                for (size_t i : cell->second) {
+                    const Point& p = points_[i];
+                    double distance = haversine_km(lat, lon, p.lat, p.lon);
+                    if (distance <= radius_km) matches.push_back({p.id, distance});
+                }
+            }
+        }
+        auto nearer = [](const GeoMatch& a, const GeoMatch& b) {
+            return a.distance_km < b.distance_km || (a.distance_km == b.distance_km && a.id < b.id);
+        };
+        if (matches.size() > limit) {
+            std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), nearer);
+            matches.resize(limit);
+        } else {
+            std::sort(matches.begin(), matches.end(), nearer);
+        }
+        return matches;
+    }
+
+private:
+    struct Point
+    {
+        int id;
+        double lat;
+        double lon;
+    };
+
+    int lat_cell(double lat) const { return static_cast<int>(std::floor(lat / cell_)); }
+    int lon_cell(double lon) const { return wrap(static_cast<int>(std::floor(lon / cell_))); }
+    int wrap(int lon_cell) const { return ((lon_cell % lon_cells_) + lon_cells_) % lon_cells_; }
+    static int64_t key(int lat_cell, int lon_cell) { return (static_cast<int64_t>(lat_cell) << 32) | static_cast<uint32_t>(lon_cell); }
+
+    double cell_;
+    int lon_cells_;
+    std::vector<Point> points_;
+    std::unordered_map<int64_t, std::vector<size_t>> cells_;
+};
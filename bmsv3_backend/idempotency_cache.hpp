@@ -0,0 +1,117 @@
+#pragma once
+
+// Bounded, TTL-limited map from Idempotency-Key to the response that was sent
+// for it. A retry that arrives while the first request is still running is
+// answered with that request's result instead of running the booking twice.
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct StoredResponse
+{
+    int code = 0;
+    std::string body;
+};
+
+class IdempotencyCache
+{
+public:
+    enum class Claim { Owner, Replay, InFlight, Mismatch };
+
+    IdempotencyCache(size_t capacity, std::chrono::seconds ttl) : capacity_(capacity), ttl_(ttl) {}
+
+    using Waiter = std::function<void(const StoredResponse&)>;
+
+    // Owner: the caller runs the request and must call complete().
+    // Replay: `stored` holds the earlier response.
+    // InFlight: `waiter` has been queued and will get the owner's response.
+    // Mismatch: the key was already used for a different request body.
+    Claim claim(const std::string& key, const std::string& fingerprint, StoredResponse& stored, Waiter waiter)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.expires_at <= now && it->second.done) {
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+            it = entries_.end();
+        }
+
+        if (it != entries_.end()) {
+            Entry& entry = it->second;
+            if (entry.fingerprint != fingerprint) return Claim::Mismatch;
+            lru_.splice(lru_.begin(), lru_, entry.lru);
+            if (entry.done) {
+                stored = entry.response;
+                return Claim::Replay;
+            }
+            entry.waiters.push_back(std::move(waiter));
+            return Claim::InFlight;
+        }
+
+        Entry& entry = entries_[key];
+        entry.fingerprint = fingerprint;
+        entry.expires_at = now + ttl_;
+        lru_.push_front(key);
+        entry.lru = lru_.begin();
+        evict();
+        return Claim::Owner;
+    }
+
+    // Publishes the owner's response to any waiters. With keep == false the key
+    // is forgotten afterwards so a later retry runs the request again.
+    void complete(const std::string& key, const StoredResponse& response, bool keep)
+    {
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end() || it->second.done) return;
+            waiters.swap(it->second.waiters);
+            if (!keep) {
+                lru_.erase(it->second.lru);
+                entries_.erase(it);
+            } else {
+                it->second.done = true;
+                it->second.response = response;
+                it->second.expires_at = std::chrono::steady_clock::now() + ttl_;
+            }
+        }
+        for (auto& waiter : waiters) waiter(response);
+    }
+
+private:
+    struct Entry
+    {
+        std::string fingerprint;
+        std::vector<Waiter> waiters;
+        bool done = false;
+        StoredResponse response;
+        std::chrono::steady_clock::time_point expires_at;
+        std::list<std::string>::iterator lru;
+    };
+
+    // Drops least recently used finished entries; in-flight ones are never evicted.
+    void evict()
+    {
+        auto it = lru_.end();
+        while (entries_.size() > capacity_ && it != lru_.begin()) {
+            --it;
+            auto entry = entries_.find(*it);
+            if (!entry->second.done) continue;
+            entries_.erase(entry);
+            it = lru_.erase(it);
+        }
+    }
+
+    size_t capacity_;
+    std::chrono::seconds ttl_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+};
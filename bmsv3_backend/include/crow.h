@@ -7938,7 +7938,11 @@ namespace crow
                 }
                 if (complete_request_handler_)
                 {
-                    complete_request_handler_();
+                    // complete_request() resets complete_request_handler_; run a copy so
+                    // the connection it keeps alive survives a call made after the route
+                    // handler has returned (asynchronous responses).
+                    auto handler = complete_request_handler_;
+                    handler();
                     manual_length_header = false;
                     skip_body = false;
                 }
@@ -9632,7 +9636,7 @@ namespace crow
                 res.complete_request_handler_ = nullptr;
                 auto self = this->shared_from_this();
                 res.is_alive_helper_ = [self]() -> bool {
-                    return self->adaptor_.is_open();
+                    return self->adaptor_.is_open() && !self->peer_closed_;
                 };
 
                 detail::middleware_call_helper<detail::middleware_call_criteria_only_global,
@@ -9647,6 +9651,8 @@ namespace crow
                     handler_->handle(req_, res, routing_handle_result_);
                     if (add_keep_alive_)
                         res.set_header("connection", "Keep-Alive");
+                    if (need_to_call_after_handlers_)
+                        watch_for_hangup();
                 }
                 else
                 {
@@ -9718,6 +9724,28 @@ namespace crow
         }
 
     private:
+        // Nothing reads the socket while an asynchronous response is pending,
+        // so a client that hangs up would go unnoticed until the write. Wait
+        // for the socket to turn readable and peek: end of stream makes
+        // res.is_alive() false, so the handler can give up on the work.
+        void watch_for_hangup()
+        {
+            auto self = this->shared_from_this();
+            adaptor_.raw_socket().async_wait(asio::socket_base::wait_read, [self](const error_code& ec) {
+                if (ec || !self->need_to_call_after_handlers_) return;
+                char byte;
+                error_code peek_ec, ignored;
+                auto& socket = self->adaptor_.raw_socket();
+                socket.non_blocking(true, ignored);
+                socket.receive(asio::buffer(&byte, 1), asio::socket_base::message_peek, peek_ec);
+                socket.non_blocking(false, ignored);
+                if (peek_ec == asio::error::would_block)
+                    self->watch_for_hangup();
+                else if (peek_ec)
+                    self->peer_closed_ = true; // eof or reset; a pipelined request leaves it be
+            });
+        }
+
         void prepare_buffers()
         {
             res.complete_request_handler_ = nullptr;
@@ -10060,6 +10088,7 @@ namespace crow
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
+        bool peer_closed_{};
 
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
@@ -10955,7 +10984,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
              uint16_t concurrency = 1,
              uint8_t timeout = 5,
              typename Adaptor::context* adaptor_ctx = nullptr):
-          acceptor_(io_context_,endpoint),
+          acceptor_(open_acceptor(io_context_, endpoint, handler->reuse_port())),
           signals_(io_context_),
           tick_timer_(io_context_),
           handler_(handler),
@@ -11087,6 +11116,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
               .join();
         }
 
+        /// Stop taking new connections; the ones already accepted keep being served.
+        void stop_accepting()
+        {
+            asio::post(io_context_, [this] {
+                shutting_down_ = true;
+                error_code ec;
+                acceptor_.close(ec);
+            });
+        }
+
         void stop()
         {
             shutting_down_ = true; // Prevent the acceptor from taking new connections
@@ -11129,6 +11168,20 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 
     private:
+        static tcp::acceptor open_acceptor(asio::io_context& io_context, const tcp::endpoint& endpoint, bool reuse_port)
+        {
+            tcp::acceptor acceptor(io_context);
+            acceptor.open(endpoint.protocol());
+            acceptor.set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+            if (reuse_port)
+                acceptor.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#endif
+            acceptor.bind(endpoint);
+            acceptor.listen();
+            return acceptor;
+        }
+
         uint16_t pick_io_context_idx()
         {
             uint16_t min_queue_idx = 0;
@@ -11163,6 +11216,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                   [this, p, &ic, context_idx](error_code ec) {
                       if (!ec)
                       {
+                          // Responses are written in more than one send; without
+                          // this, keep-alive clients wait out delayed ACKs (~40ms).
+                          error_code ignored;
+                          p->socket().set_option(tcp::no_delay(true), ignored);
                           asio::post(ic,
                             [p] {
                                 p->start();
@@ -14445,6 +14502,18 @@ namespace crow
             }
         }
 
+        /// \brief Let several processes listen on the same port (SO_REUSEPORT, where supported)
+        self_t& reuse_port(bool enabled)
+        {
+            reuse_port_ = enabled;
+            return *this;
+        }
+
+        bool reuse_port() const
+        {
+            return reuse_port_;
+        }
+
         /// \brief Set the connection timeout in seconds (default is 5)
         self_t& timeout(std::uint8_t timeout)
         {
@@ -14675,6 +14744,21 @@ namespace crow
             });
         }
 
+        /// \brief Stop accepting new connections without closing existing ones
+        void stop_accepting()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                if (ssl_server_) { ssl_server_->stop_accepting(); }
+            }
+            else
+#endif
+            {
+                if (server_) { server_->stop_accepting(); }
+            }
+        }
+
         /// \brief Stop the server
         void stop()
         {
@@ -14882,6 +14966,7 @@ namespace crow
     private:
         std::uint8_t timeout_{5};
         uint16_t port_ = 80;
+        bool reuse_port_ = false;
         uint16_t concurrency_ = 2;
         uint64_t max_payload_{UINT64_MAX};
         std::string server_name_ = std::string("Crow/") + VERSION;
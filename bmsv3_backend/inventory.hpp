@@ -0,0 +1,466 @@
+#pragma once
+
+// Seat inventory sharded across a fixed set of worker threads.
+// Every showtime belongs to exactly one shard (showtime_id % shard count) and
+// only that shard's thread ever touches its ShowtimeSeats, so seat checks and
+// updates need no locks. Work reaches a shard through a lock-free MPSC
+// mailbox, and database writes queued while draining the mailbox are
+// committed together in one transaction per batch. Shards also hand out
+// copies of their seat state for snapshots (seat_snapshot.hpp) and take it
+// back on startup.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sqlite3.h>
+#include "log.hpp"
+#include "seat_map.hpp"
+#include "seat_snapshot.hpp"
+#include "slow_query_log.hpp"
+#include "tracing.hpp"
+
+// Multi-producer single-consumer queue (Vyukov's intrusive design): producers
+// only swap the head pointer, the single consumer walks from the tail.
+template <class T>
+class MpscQueue
+{
+public:
+    MpscQueue() : head_(new Node), tail_(head_.load()) {}
+    ~MpscQueue()
+    {
+        T ignored;
+        while (pop(ignored)) {}
+        delete tail_;
+    }
+
+    void push(T value)
+    {
+        Node* node = new Node;
+        node->value = std::move(value);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        // seq_cst pairs with the consumer's sleeping_ store so a wakeup is never lost.
+        prev->next.store(node, std::memory_order_seq_cst);
+    }
+
+    // Consumer thread only.
+    bool pop(T& out)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(next->value);
+        tail_ = next;
+        delete tail;
+        return true;
+    }
+
+    // Consumer thread only.
+    bool empty() const { return tail_->next.load(std::memory_order_seq_cst) == nullptr; }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+    std::atomic<Node*> head_;
+    Node* tail_;
+};
+
+class InventoryShard;
+
+// A durable write queued by a shard. `apply` runs inside the batch
+// transaction; `done` runs on the shard thread once the batch has committed
+// (true) or the write was rolled back (false).
+struct ShardWrite
+{
+    std::function<bool(sqlite3*)> apply;
+    std::function<void(bool)> done;
+    // The showtime whose seats `apply` books or frees, if any. Such a write
+    // moves Showtimes.SeatsSeq on by one, and so does the shard's copy once
+    // the write commits.
+    int showtime_id = 0;
+    uint64_t trace_id = 0; // set by queue_write
+};
+
+// Reads a showtime's seat state and sets `seq` to the SeatsSeq it reflects.
+using ShowtimeLoader = std::function<std::unique_ptr<ShowtimeSeats>(sqlite3*, int showtime_id, uint64_t& seq)>;
+
+// Runs on the shard thread whenever seats become free again: a cancelled
+// booking, or a hold that expired or was given up.
+using SeatReleaseListener = std::function<void(InventoryShard&, int showtime_id, const std::vector<int>& seats)>;
+
+// Called on the shard thread with the showtime's current state (nullptr if it
+// no longer exists) once it changes or the watch times out.
+using SeatWatcher = std::function<void(ShowtimeSeats*)>;
+
+class InventoryShard
+{
+public:
+    // With a non-zero refresh_after, seat state older than that is reloaded
+    // from the database on next use (several server processes share one file).
+    InventoryShard(int index, const std::string& db_path, ShowtimeLoader loader,
+                   std::chrono::milliseconds refresh_after = std::chrono::milliseconds(0))
+        : index_(index), loader_(std::move(loader)), refresh_after_(refresh_after)
+    {
+        if (sqlite3_open(db_path.c_str(), &db_) != SQLITE_OK) {
+            log_error("inventory shard can't open database", {{"shard", index_}, {"path", db_path}, {"error", sqlite3_errmsg(db_)}});
+        }
+        sqlite3_busy_timeout(db_, 5000);
+        watch_statements(db_);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~InventoryShard()
+    {
+        running_ = false;
+        wake();
+        thread_.join();
+        sqlite3_close(db_);
+    }
+
+    int index() const { return index_; }
+
+    // Any thread: hands `task` to this shard's thread.
+    void post(std::function<void(InventoryShard&)> task)
+    {
+        if (uint64_t trace = current_trace()) {
+            auto posted_us = Tracer::now_us();
+            task = [trace, posted_us, task = std::move(task)](InventoryShard& shard) {
+                TraceScope scope(trace);
+                trace_thread_name("shard " + std::to_string(shard.index()));
+                trace_record("shard.queue", "inventory", posted_us, Tracer::now_us());
+                TraceSpan span("shard.task", "inventory");
+                task(shard);
+            };
+        }
+        mailbox_.push(std::move(task));
+        // Only the producer that finds the shard parked takes the lock to wake
+        // it; while the shard is busy, or once one producer has woken it,
+        // posting is the mailbox push and this one atomic.
+        if (sleeping_.load(std::memory_order_seq_cst) && sleeping_.exchange(false, std::memory_order_seq_cst)) wake();
+    }
+
+    // --- Shard thread only below this line ---
+
+    // Loads the showtime on first use; nullptr if it doesn't exist.
+    ShowtimeSeats* showtime(int showtime_id)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto it = showtimes_.find(showtime_id);
+        if (it != showtimes_.end()) {
+            // Other processes may have booked seats since we loaded them. Never
+            // reload while this shard has uncommitted claims of its own.
+            bool stale = refresh_after_.count() > 0 && now - it->second.loaded_at >= refresh_after_;
+            if (!stale || !pending_writes_.empty()) return it->second.seats.get();
+            reload(showtime_id);
+            it = showtimes_.find(showtime_id);
+            return it == showtimes_.end() ? nullptr : it->second.seats.get();
+        }
+        uint64_t seq = 0;
+        auto seats = loader_(db_, showtime_id, seq);
+        if (!seats) return nullptr;
+        ShowtimeSeats* raw = seats.get();
+        showtimes_[showtime_id] = {std::move(seats), now, seq};
+        return raw;
+    }
+
+    // Installs seat state taken from a snapshot, unless the showtime is
+    // already loaded.
+    void restore(int showtime_id, std::unique_ptr<ShowtimeSeats> seats, uint64_t seq)
+    {
+        if (showtimes_.count(showtime_id)) return;
+        showtimes_[showtime_id] = {std::move(seats), std::chrono::steady_clock::now(), seq};
+    }
+
+    // Appends the booked seats of every loaded showtime to `out`. Showtimes
+    // with writes still waiting for the batch commit are left out, since
+    // their claims may yet be rolled back.
+    void snapshot(std::vector<SeatSnapshotEntry>& out) const
+    {
+        std::vector<int> pending;
+        for (const auto& write : pending_writes_) {
+            if (write.showtime_id) pending.push_back(write.showtime_id);
+        }
+        for (const auto& entry : showtimes_) {
+            if (std::find(pending.begin(), pending.end(), entry.first) != pending.end()) continue;
+            const ShowtimeSeats& seats = *entry.second.seats;
+            out.push_back({entry.first, entry.second.seq, layout_hash(seats.layout()), seats.booked_masks()});
+        }
+    }
+
+    // Rebuilds the showtime from the database, keeping its holds.
+    void reload(int showtime_id)
+    {
+        auto it = showtimes_.find(showtime_id);
+        if (it == showtimes_.end()) return;
+        uint64_t seq = 0;
+        auto fresh = loader_(db_, showtime_id, seq);
+        if (!fresh) {
+            showtimes_.erase(it);
+            return;
+        }
+        fresh->adopt_holds(*it->second.seats);
+        const ShowtimeSeats& old = *it->second.seats;
+        fresh->set_version(fresh->same_occupancy(old) ? old.version() : old.version() + 1);
+        it->second = {std::move(fresh), std::chrono::steady_clock::now(), seq};
+    }
+
+    void queue_write(ShardWrite write)
+    {
+        write.trace_id = current_trace();
+        pending_writes_.push_back(std::move(write));
+    }
+
+    // Set once at startup, before any work is posted.
+    void set_release_listener(SeatReleaseListener listener) { release_listener_ = std::move(listener); }
+
+    // Reports seats that are free again to the release listener.
+    void seats_released(int showtime_id, const std::vector<int>& seats)
+    {
+        if (release_listener_ && !seats.empty()) release_listener_(*this, showtime_id, seats);
+    }
+
+    // Drops the showtime's expired holds, reporting the seats they free.
+    ShowtimeSeats* expire_holds(int showtime_id)
+    {
+        ShowtimeSeats* seats = showtime(showtime_id);
+        if (seats) seats_released(showtime_id, seats->expire_holds(std::chrono::steady_clock::now()));
+        return seats;
+    }
+
+    // Answers `watcher` as soon as the showtime's version differs from `since`,
+    // or with the unchanged state once `timeout` has passed.
+    void watch(int showtime_id, uint64_t since, std::chrono::steady_clock::duration timeout, SeatWatcher watcher)
+    {
+        ShowtimeSeats* seats = showtime(showtime_id);
+        if (!seats || seats->version() != since) {
+            watcher(seats);
+            return;
+        }
+        watchers_[showtime_id].push_back({since, std::chrono::steady_clock::now() + timeout, std::move(watcher)});
+    }
+
+    // Answers every parked watch with the current state.
+    void release_watchers() { notify_watchers(std::chrono::steady_clock::time_point::max()); }
+
+    sqlite3* db() const { return db_; }
+
+private:
+    static constexpr size_t MAX_BATCH = 256;
+
+    void run()
+    {
+        auto last_sweep = std::chrono::steady_clock::now();
+        while (running_) {
+            std::function<void(InventoryShard&)> task;
+            size_t handled = 0;
+            while (handled < MAX_BATCH && mailbox_.pop(task)) {
+                task(*this);
+                ++handled;
+            }
+            flush_writes();
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_sweep >= std::chrono::seconds(1)) {
+                sweep_holds(now);
+                last_sweep = now;
+            }
+            notify_watchers(now);
+            if (handled) continue;
+
+            // Nothing queued: sleep until a producer wakes us or the next hold sweep.
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleeping_.store(true, std::memory_order_seq_cst);
+            if (mailbox_.empty() && running_) wake_cv_.wait_for(lock, std::chrono::seconds(1));
+            sleeping_.store(false, std::memory_order_seq_cst);
+        }
+        flush_writes();
+        release_watchers();
+    }
+
+    void wake()
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_cv_.notify_one();
+    }
+
+    void flush_writes()
+    {
+        if (pending_writes_.empty()) return;
+        std::vector<ShardWrite> batch;
+        batch.swap(pending_writes_);
+
+        std::vector<bool> applied(batch.size(), false);
+        bool committed = sqlite3_exec(db_, "BEGIN IMMEDIATE", 0, 0, 0) == SQLITE_OK;
+        if (committed) {
+            // Each write gets its own savepoint so one failure doesn't sink the batch.
+            for (size_t i = 0; i < batch.size(); ++i) {
+                TraceScope scope(batch[i].trace_id);
+                TraceSpan span("shard.write", "inventory");
+                sqlite3_exec(db_, "SAVEPOINT shard_write", 0, 0, 0);
+                applied[i] = batch[i].apply(db_);
+                sqlite3_exec(db_, applied[i] ? "RELEASE shard_write" : "ROLLBACK TO shard_write; RELEASE shard_write", 0, 0, 0);
+            }
+            int64_t commit_started = Tracer::now_us();
+            committed = sqlite3_exec(db_, "COMMIT", 0, 0, 0) == SQLITE_OK;
+            // The batch's commit is shared by every write in it.
+            int64_t commit_ended = Tracer::now_us();
+            for (const auto& write : batch) {
+                TraceScope scope(write.trace_id);
+                trace_record("shard.commit", "inventory", commit_started, commit_ended, std::to_string(batch.size()) + " writes");
+            }
+            if (!committed) {
+                log_error("inventory commit failed", {{"shard", index_}, {"writes", batch.size()}, {"error", sqlite3_errmsg(db_)}});
+                sqlite3_exec(db_, "ROLLBACK", 0, 0, 0);
+            }
+        } else {
+            log_error("inventory BEGIN failed", {{"shard", index_}, {"writes", batch.size()}, {"error", sqlite3_errmsg(db_)}});
+        }
+        if (committed) {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!applied[i] || !batch[i].showtime_id) continue;
+                auto it = showtimes_.find(batch[i].showtime_id);
+                if (it != showtimes_.end()) ++it->second.seq;
+            }
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            TraceScope scope(batch[i].trace_id);
+            if (batch[i].done) batch[i].done(committed && applied[i]);
+        }
+    }
+
+    void notify_watchers(std::chrono::steady_clock::time_point now)
+    {
+        for (auto it = watchers_.begin(); it != watchers_.end();) {
+            auto found = showtimes_.find(it->first);
+            ShowtimeSeats* seats = found == showtimes_.end() ? nullptr : found->second.seats.get();
+            auto& list = it->second;
+            for (size_t i = 0; i < list.size();) {
+                if (seats && seats->version() == list[i].since && list[i].deadline > now) {
+                    ++i;
+                    continue;
+                }
+                list[i].notify(seats);
+                list.erase(list.begin() + i);
+            }
+            it = list.empty() ? watchers_.erase(it) : std::next(it);
+        }
+    }
+
+    void sweep_holds(std::chrono::steady_clock::time_point now)
+    {
+        // Listeners may touch showtimes_, so report after the walk.
+        std::vector<std::pair<int, std::vector<int>>> released;
+        for (auto& entry : showtimes_) {
+            auto seats = entry.second.seats->expire_holds(now);
+            if (!seats.empty()) released.emplace_back(entry.first, std::move(seats));
+        }
+        for (const auto& r : released) seats_released(r.first, r.second);
+    }
+
+    struct Watch
+    {
+        uint64_t since;
+        std::chrono::steady_clock::time_point deadline;
+        SeatWatcher notify;
+    };
+
+    struct LoadedShowtime
+    {
+        std::unique_ptr<ShowtimeSeats> seats;
+        std::chrono::steady_clock::time_point loaded_at;
+        uint64_t seq; // Showtimes.SeatsSeq as of `seats`
+    };
+
+    int index_;
+    ShowtimeLoader loader_;
+    std::chrono::milliseconds refresh_after_;
+    sqlite3* db_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> running_{true};
+
+    MpscQueue<std::function<void(InventoryShard&)>> mailbox_;
+    std::atomic<bool> sleeping_{false};
+    std::mutex sleep_mutex_; // parks an idle shard; a producer takes it only to wake one
+    std::condition_variable wake_cv_;
+
+    std::unordered_map<int, LoadedShowtime> showtimes_;
+    std::vector<ShardWrite> pending_writes_;
+    SeatReleaseListener release_listener_;
+    std::unordered_map<int, std::vector<Watch>> watchers_;
+};
+
+class SeatInventory
+{
+public:
+    SeatInventory(size_t shard_count, const std::string& db_path, ShowtimeLoader loader,
+                  std::chrono::milliseconds refresh_after = std::chrono::milliseconds(0))
+    {
+        for (size_t i = 0; i < shard_count; ++i) {
+            shards_.push_back(std::make_unique<InventoryShard>(static_cast<int>(i), db_path, loader, refresh_after));
+        }
+    }
+
+    InventoryShard& shard_for(int showtime_id)
+    {
+        size_t key = static_cast<size_t>(showtime_id < 0 ? -showtime_id : showtime_id);
+        return *shards_[key % shards_.size()];
+    }
+
+    void post(int showtime_id, std::function<void(InventoryShard&)> task) { shard_for(showtime_id).post(std::move(task)); }
+
+    void set_release_listener(SeatReleaseListener listener)
+    {
+        for (auto& shard : shards_) shard->set_release_listener(listener);
+    }
+
+    // Collects every shard's seat state for a snapshot. Blocks until all the
+    // shards have got round to it, so never call it from a shard thread.
+    std::vector<SeatSnapshotEntry> snapshot()
+    {
+        struct Collected
+        {
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t remaining;
+            std::vector<SeatSnapshotEntry> entries;
+        };
+        auto collected = std::make_shared<Collected>();
+        collected->remaining = shards_.size();
+        for (auto& shard : shards_) {
+            shard->post([collected](InventoryShard& s) {
+                std::vector<SeatSnapshotEntry> entries;
+                s.snapshot(entries);
+                std::lock_guard<std::mutex> lock(collected->mutex);
+                std::move(entries.begin(), entries.end(), std::back_inserter(collected->entries));
+                if (--collected->remaining == 0) collected->done.notify_one();
+            });
+        }
+        std::unique_lock<std::mutex> lock(collected->mutex);
+        collected->done.wait(lock, [&] { return collected->remaining == 0; });
+        return std::move(collected->entries);
+    }
+
+    // Answers every parked watch now, e.g. when the server starts draining.
+    void release_watchers()
+    {
+        for (auto& shard : shards_) shard->post([](InventoryShard& s) { s.release_watchers(); });
+    }
+
+    size_t size() const { return shards_.size(); }
+    InventoryShard& shard(size_t i) { return *shards_[i]; }
+
+private:
+    std::vector<std::unique_ptr<InventoryShard>> shards_;
+};
@@ -0,0 +1,349 @@
+#pragma once
+
+// Asynchronous structured logging. log_info("msg", {{"key", value}, ...})
+// moves the record into a ring buffer owned by the calling thread (single
+// producer, single consumer, no locks) and returns; nothing is formatted or
+// written on that thread. A background thread drains every ring each
+// DRAIN_INTERVAL and writes the records as logfmt lines, e.g.
+//
+//   time=2025-08-22T10:00:00.123Z level=error msg="booking insert failed" showtime_id=3 user_id=7 error="..."
+//
+// to stderr or to a file that is rotated once it passes a size limit
+// (file -> file.1 -> file.2 ...). A thread whose ring is full drops the record
+// and counts it in log_records_dropped_total rather than wait.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "metrics.hpp"
+#include "tracing.hpp"
+
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+inline const char* log_level_name(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Debug: return "debug";
+    case LogLevel::Info: return "info";
+    case LogLevel::Warning: return "warning";
+    case LogLevel::Error: return "error";
+    }
+    return "info";
+}
+
+// Returns false for an unknown name.
+inline bool parse_log_level(const std::string& name, LogLevel& level)
+{
+    for (LogLevel l : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error}) {
+        if (name == log_level_name(l)) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+// One key/value pair of a record. Keys are string literals.
+struct LogField
+{
+    LogField(const char* k, std::string v) : key(k), value(std::move(v)) {}
+    LogField(const char* k, const char* v) : key(k), value(v ? v : "") {}
+
+    template <class T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    LogField(const char* k, T v) : key(k)
+    {
+        if (std::is_floating_point<T>::value) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(v));
+            value = buf;
+        } else {
+            value = std::to_string(v);
+        }
+    }
+
+    const char* key;
+    std::string value;
+};
+
+struct LogRecord
+{
+    LogLevel level = LogLevel::Info;
+    std::chrono::system_clock::time_point when;
+    uint64_t trace_id = 0;
+    std::string message;
+    std::vector<LogField> fields;
+};
+
+// One thread's pending records. Only its thread pushes and only the drain
+// thread pops, so the two indices are all the synchronisation needed.
+class LogRing
+{
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    LogRing() : slots_(CAPACITY) {}
+
+    bool push(LogRecord&& record)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= CAPACITY) return false;
+        slots_[head % CAPACITY] = std::move(record);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class F>
+    void drain(F&& f)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            f(std::move(slots_[tail % CAPACITY]));
+            slots_[tail % CAPACITY] = LogRecord();
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    std::atomic<bool> abandoned{false}; // its thread has exited
+
+private:
+    std::vector<LogRecord> slots_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+class Logger
+{
+public:
+    static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
+
+    ~Logger() { stop(); }
+
+    // Starts the drain thread. An empty path logs to stderr; otherwise the file
+    // is appended to and rotated at max_bytes, keeping `keep` old files.
+    // Records logged before start() are held (up to a ring's worth per thread).
+    void start(const std::string& path, size_t max_bytes, int keep)
+    {
+        path_ = path;
+        max_bytes_ = max_bytes;
+        keep_ = keep;
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    // Writes out whatever is pending and stops the drain thread.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= this->level(); }
+
+    void write(LogLevel level, std::string message, std::vector<LogField> fields)
+    {
+        static Counter& dropped = metrics().counter("log_records_dropped_total", "Log records dropped because their thread's ring was full");
+        if (!enabled(level)) return;
+        LogRecord record;
+        record.level = level;
+        record.when = std::chrono::system_clock::now();
+        record.trace_id = current_trace();
+        record.message = std::move(message);
+        record.fields = std::move(fields);
+        if (!local().push(std::move(record))) dropped.inc();
+    }
+
+private:
+    LogRing& local()
+    {
+        struct Holder
+        {
+            std::shared_ptr<LogRing> ring;
+            ~Holder()
+            {
+                if (ring) ring->abandoned.store(true, std::memory_order_release);
+            }
+        };
+        thread_local Holder holder;
+        if (!holder.ring) {
+            holder.ring = std::make_shared<LogRing>();
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void run()
+    {
+        out_ = path_.empty() ? stderr : open();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            bool last = !running_;
+            std::vector<std::shared_ptr<LogRing>> rings = rings_;
+            // A ring whose thread had exited before this drain is empty after it.
+            std::vector<std::shared_ptr<LogRing>> finished;
+            for (const auto& ring : rings) {
+                if (ring->abandoned.load(std::memory_order_acquire)) finished.push_back(ring);
+            }
+            lock.unlock();
+            drain(rings);
+            lock.lock();
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [&](const std::shared_ptr<LogRing>& ring) {
+                return std::find(finished.begin(), finished.end(), ring) != finished.end();
+            }), rings_.end());
+            if (last) break;
+            wake_.wait_for(lock, DRAIN_INTERVAL, [this] { return !running_; });
+        }
+        if (out_ && out_ != stderr) std::fclose(out_);
+        out_ = nullptr;
+    }
+
+    void drain(const std::vector<std::shared_ptr<LogRing>>& rings)
+    {
+        std::vector<LogRecord> batch;
+        for (const auto& ring : rings) {
+            ring->drain([&](LogRecord&& record) { batch.push_back(std::move(record)); });
+        }
+        if (batch.empty() || !out_) return;
+        std::stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) { return a.when < b.when; });
+        std::string text;
+        for (const auto& record : batch) format(record, text);
+        std::fwrite(text.data(), 1, text.size(), out_);
+        std::fflush(out_);
+        written_ += text.size();
+        if (out_ != stderr && written_ >= max_bytes_) rotate();
+    }
+
+    FILE* open()
+    {
+        FILE* f = std::fopen(path_.c_str(), "a");
+        if (!f) {
+            std::fprintf(stderr, "Can't open log file %s, logging to stderr\n", path_.c_str());
+            return stderr;
+        }
+        std::fseek(f, 0, SEEK_END);
+        written_ = static_cast<size_t>(std::max(0L, std::ftell(f)));
+        return f;
+    }
+
+    void rotate()
+    {
+        std::fclose(out_);
+        for (int i = keep_; i > 0; --i) {
+            std::string from = i == 1 ? path_ : path_ + "." + std::to_string(i - 1);
+            std::string to = path_ + "." + std::to_string(i);
+            std::rename(from.c_str(), to.c_str());
+        }
+        if (keep_ <= 0) std::remove(path_.c_str());
+        out_ = open();
+    }
+
+    static void append_value(std::string& out, const std::string& value)
+    {
+        bool quote = value.empty() || value.find_first_of(" =\"\\\n\r\t") != std::string::npos;
+        if (!quote) {
+            out += value;
+            return;
+        }
+        out += '"';
+        for (char c : value) {
+            if (c == '"' || c == '\\') out += '\\';
+            if (c == '\n') out += "\\n";
+            else if (c == '\r') out += "\\r";
+            else if (c == '\t') out += "\\t";
+            else out += c;
+        }
+        out += '"';
+    }
+
+    static void format(const LogRecord& record, std::string& out)
+    {
+        char when[40];
+        std::time_t seconds = std::chrono::system_clock::to_time_t(record.when);
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(record.when.time_since_epoch()).count() % 1000;
+        std::tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        size_t n = std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(when + n, sizeof(when) - n, ".%03dZ", static_cast<int>(millis));
+
+        out += "time=";
+        out += when;
+        out += " level=";
+        out += log_level_name(record.level);
+        out += " msg=";
+        append_value(out, record.message);
+        for (const auto& field : record.fields) {
+            out += ' ';
+            out += field.key;
+            out += '=';
+            append_value(out, field.value);
+        }
+        if (record.trace_id) out += " trace_id=" + std::to_string(record.trace_id);
+        out += '\n';
+    }
+
+    std::atomic<LogLevel> level_{LogLevel::Info};
+    std::string path_;
+    size_t max_bytes_ = 0;
+    int keep_ = 0;
+    FILE* out_ = nullptr;   // drain thread only
+    size_t written_ = 0;    // drain thread only
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread thread_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+};
+
+inline Logger& logger()
+{
+    static Logger instance;
+    return instance;
+}
+
+inline void log_debug(std::string message, std::vector<LogField> fields = {})
+{
+    logger().write(LogLevel::Debug, std::move(message), std::move(fields));
+}
+
+inline void log_info(std::string message, std::vector<LogField> fields = {})
+{
+    logger().write(LogLevel::Info, std::move(message), std::move(fields));
+}
+
+inline void log_warning(std::string message, std::vector<LogField> fields = {})
+{
+    logger().write(LogLevel::Warning, std::move(message), std::move(fields));
+}
+
+inline void log_error(std::string message, std::vector<LogField> fields = {})
+{
+    logger().write(LogLevel::Error, std::move(message), std::move(fields));
+}
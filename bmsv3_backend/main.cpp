@@ -5,17 +5,46 @@
 // Standard C++ and library headers go NEXT.
 #include <iostream>
 #include <string>
-#include <random> // For generating session tokens
-#include <sstream> // For generating session tokens
+#include <sstream>
 #include <vector>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <ctime>
+#include <limits>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
 #include <sqlite3.h>
 #include "include/json.hpp"
+#include "seat_layout.hpp"
+#include "seat_map.hpp"
+#include "session_token.hpp"
+#include "inventory.hpp"
+#include "idempotency_cache.hpp"
+#include "singleflight.hpp"
+#include "waitlist.hpp"
+#include "ttl_cache.hpp"
+#include "schedule.hpp"
+#include "catalog.hpp"
+#include "log.hpp"
+#include "warmup.hpp"
+#include "trending.hpp"
 
 // The Crow headers go LAST.
 #include "include/crow.h"
+// These use Crow's types or the asio bundled with it, so they come after it.
+#include "db_executor.hpp"
+#include "query_guard.hpp"
+#include "request_tracker.hpp"
+#include "supervisor.hpp"
 
 using json = nlohmann::json;
 sqlite3* db;
+std::string db_path = "blockmyseat.db";
 
 static int callback_is_empty(void* data, int argc, char** argv, char** azColName) 
 {
@@ -23,37 +52,459 @@ static int callback_is_empty(void* data, int argc, char** argv, char** azColName
     *count = argc > 0 ? atoi(argv[0]) : 0;
     return 0;
 }
-std::string generate_session_token() {
-    std::stringstream ss;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, 255);
-    for (int i = 0; i < 32; ++i) {
-        ss << std::hex << distrib(gen);
+
+static bool column_exists(const char* table, const char* column)
+{
+    sqlite3_stmt* stmt;
+    std::string pragma = std::string("PRAGMA table_info(") + table + ")";
+    bool found = false;
+    if (sqlite3_prepare_v2(db, pragma.c_str(), -1, &stmt, 0) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))) == column) found = true;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Lets an existing blockmyseat.db pick up new columns without being deleted.
+static void add_column_if_missing(const char* table, const char* column, const char* definition)
+{
+    if (column_exists(table, column)) return;
+
+    std::string sql = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + definition;
+    char* zErrMsg = 0;
+    if (sqlite3_exec(db, sql.c_str(), 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("add column failed", {{"table", table}, {"column", column}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+}
+
+// Showtimes without an auditorium use auditorium 1, same as seats.js does.
+// `seats_seq`, if given, gets the showtime's SeatsSeq.
+bool load_showtime_layout(sqlite3* conn, int showtime_id, SeatLayout& layout, uint64_t* seats_seq = nullptr)
+{
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT A.Layout, S.SeatsSeq FROM Showtimes AS S "
+                      "LEFT JOIN Auditoriums AS A ON A.AuditoriumID = COALESCE(S.AuditoriumID, 1) "
+                      "WHERE S.ShowtimeID = ?";
+    bool found = false;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, showtime_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            found = true;
+            const unsigned char* text = sqlite3_column_text(stmt, 0);
+            layout = text ? parse_seat_layout(reinterpret_cast<const char*>(text)) : SeatLayout{};
+            if (seats_seq) *seats_seq = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Tickets booked per movie and showtime over the last hour and day, fed by
+// every booking commit (see trending.hpp). Each worker counts its own.
+TrendingTracker trending;
+const size_t MAX_TRENDING = 50;
+// The showtimes trending over the last hour get their seat maps loaded, and
+// refreshed when stale, this often.
+const size_t HOT_SHOWTIMES = 50;
+const auto HOT_SHOWTIME_REFRESH = std::chrono::milliseconds(1000);
+
+// Seat state per showtime lives on the inventory shard that owns it. A shard
+// builds it from BookingSeats the first time the showtime is touched and keeps it
+// in step with every booking it commits afterwards.
+std::unique_ptr<SeatInventory> seat_inventory;
+const auto SEAT_HOLD_TTL = std::chrono::minutes(5);
+const auto SEAT_WATCH_TIMEOUT = std::chrono::seconds(20);
+
+// SeatsSeq is read before the seats: if another process books in between, the
+// state is newer than its sequence number says, which only costs a reload
+// when it is restored from a snapshot. The other way round it would be wrong.
+std::unique_ptr<ShowtimeSeats> load_showtime_seats(sqlite3* conn, int showtime_id, uint64_t& seq)
+{
+    SeatLayout layout;
+    if (!load_showtime_layout(conn, showtime_id, layout, &seq)) return nullptr;
+    auto seats = std::make_unique<ShowtimeSeats>(layout);
+
+    // One range of the BookingSeats primary key.
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, "SELECT SeatIndex FROM BookingSeats WHERE ShowtimeID = ?", -1, &stmt, 0) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, showtime_id);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int index = sqlite3_column_int(stmt, 0);
+            if (index >= 0 && index < layout.seat_count()) seats->set_booked(index, true);
+        }
+    }
+    sqlite3_finalize(stmt);
+    return seats;
+}
+
+// Hands the showtimes in the seat snapshot at `path` to their shards. Every
+// shard installs the ones whose SeatsSeq is unchanged from the mapped masks
+// and reloads the rest from BookingSeats, all shards at once. This only
+// queues the work: requests a shard gets meanwhile wait behind it.
+void restore_seat_snapshot(const std::string& path, std::shared_ptr<WarmUp::Stage> stage)
+{
+    auto snapshot = std::make_shared<SeatSnapshot>();
+    if (!snapshot->open(path)) {
+        stage->start(0);
+        return;
+    }
+    auto started = std::chrono::steady_clock::now();
+
+    // The current SeatsSeq and layout of every showtime, in one scan.
+    struct Current
+    {
+        uint64_t seq;
+        const SeatLayout* layout;
+    };
+    auto layouts = std::make_shared<std::unordered_map<std::string, SeatLayout>>();
+    std::unordered_map<int, Current> current;
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT S.ShowtimeID, S.SeatsSeq, COALESCE(A.Layout, '') FROM Showtimes AS S "
+                      "LEFT JOIN Auditoriums AS A ON A.AuditoriumID = COALESCE(S.AuditoriumID, 1)";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            auto layout = layouts->find(text);
+            if (layout == layouts->end()) {
+                SeatLayout parsed = text.empty() ? SeatLayout{} : parse_seat_layout(text);
+                layout = layouts->emplace(text, parsed).first;
+            }
+            current[sqlite3_column_int(stmt, 0)] = {static_cast<uint64_t>(sqlite3_column_int64(stmt, 1)), &layout->second};
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    struct Restore
+    {
+        const SeatSnapshotView* saved;
+        const SeatLayout* layout; // nullptr: changed since, reload it
+    };
+    std::vector<std::vector<Restore>> per_shard(seat_inventory->size());
+    for (const auto& saved : snapshot->entries()) {
+        auto it = current.find(saved.showtime_id);
+        if (it == current.end()) continue; // deleted since
+        bool unchanged = it->second.seq == saved.seq && layout_hash(*it->second.layout) == saved.layout_hash;
+        per_shard[seat_inventory->shard_for(saved.showtime_id).index()].push_back({&saved, unchanged ? it->second.layout : nullptr});
+    }
+    size_t total = 0;
+    for (const auto& work : per_shard) total += work.size();
+    stage->start(total);
+
+    struct Progress
+    {
+        std::atomic<size_t> shards_left;
+        std::atomic<size_t> restored{0};
+        std::atomic<size_t> reloaded{0};
+    };
+    auto progress = std::make_shared<Progress>();
+    progress->shards_left = per_shard.size();
+    for (size_t i = 0; i < per_shard.size(); ++i) {
+        seat_inventory->shard(i).post([snapshot, layouts, progress, started, stage, work = std::move(per_shard[i])](InventoryShard& shard) {
+            size_t restored = 0, reloaded = 0;
+            for (const auto& item : work) {
+                const SeatSnapshotView& saved = *item.saved;
+                if (item.layout) {
+                    auto seats = std::make_unique<ShowtimeSeats>(*item.layout);
+                    if (seats->load_booked_masks(saved.booked, saved.mask_count)) {
+                        shard.restore(saved.showtime_id, std::move(seats), saved.seq);
+                        ++restored;
+                        stage->done();
+                        continue;
+                    }
+                }
+                shard.showtime(saved.showtime_id);
+                ++reloaded;
+                stage->done();
+            }
+            progress->restored += restored;
+            progress->reloaded += reloaded;
+            if (--progress->shards_left > 0) return;
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            log_info("seat snapshot restored", {{"restored", progress->restored.load()}, {"reloaded", progress->reloaded.load()},
+                                                {"elapsed_ms", elapsed}});
+        });
+    }
+}
+
+// Fills SeatsRemaining/PremiumRemaining for showtimes that don't have them yet
+// (new rows, or a database created before the columns existed). After this the
+// counters are only ever adjusted by the booking transaction.
+void init_seat_counters()
+{
+    std::vector<int> showtime_ids;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT ShowtimeID FROM Showtimes WHERE SeatsRemaining IS NULL OR PremiumRemaining IS NULL", -1, &stmt, 0) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) showtime_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    if (showtime_ids.empty()) return;
+
+    log_info("initialising seat counters", {{"showtimes", showtime_ids.size()}});
+    sqlite3_exec(db, "BEGIN", 0, 0, 0);
+    for (int showtime_id : showtime_ids) {
+        SeatLayout layout;
+        // Left NULL, and tried again next start, until its auditorium has a readable layout.
+        if (!load_showtime_layout(db, showtime_id, layout) || layout.seats_per_row() == 0) {
+            log_warning("showtime has no seat layout", {{"showtime_id", showtime_id}});
+            continue;
+        }
+        int seats_remaining = layout.seat_count();
+        int premium_remaining = layout.premium_seat_count();
+
+        if (sqlite3_prepare_v2(db, "SELECT SeatIndex FROM BookingSeats WHERE ShowtimeID = ?", -1, &stmt, 0) == SQLITE_OK) {
+            sqlite3_bind_int(stmt, 1, showtime_id);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                seats_remaining--;
+                if (is_premium_index(layout, sqlite3_column_int(stmt, 0))) premium_remaining--;
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (sqlite3_prepare_v2(db, "UPDATE Showtimes SET SeatsRemaining = ?, PremiumRemaining = ? WHERE ShowtimeID = ?", -1, &stmt, 0) == SQLITE_OK) {
+            sqlite3_bind_int(stmt, 1, seats_remaining);
+            sqlite3_bind_int(stmt, 2, premium_remaining);
+            sqlite3_bind_int(stmt, 3, showtime_id);
+            sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_exec(db, "COMMIT", 0, 0, 0);
+}
+
+// Adds showtimes not yet counted in OccupancyRollup (new rows, or a database
+// created before the table existed) to it, seats sold taken from the seat
+// counters. Runs in one write transaction, so workers starting together
+// don't count a showtime twice; from then on the booking transactions keep
+// the rollup current (roll_up_seats()).
+void init_occupancy_rollup()
+{
+    sqlite3_exec(db, "BEGIN IMMEDIATE", 0, 0, 0);
+    struct Pending
+    {
+        int showtime_id;
+        std::string day;
+        int movie_id, venue_id, seats_remaining, premium_remaining;
+        int64_t normal_cents, premium_cents;
+    };
+    std::vector<Pending> pending;
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT S.ShowtimeID, substr(S.ShowtimeDateTime, 1, 10), IFNULL(S.MovieID, 0), IFNULL(S.VenueID, 0), "
+                      "S.SeatsRemaining, S.PremiumRemaining, CAST(ROUND(IFNULL(A.NormalPrice, 0) * 100) AS INTEGER), "
+                      "CAST(ROUND(IFNULL(A.PremiumPrice, 0) * 100) AS INTEGER) "
+                      "FROM Showtimes AS S LEFT JOIN Auditoriums AS A ON A.AuditoriumID = COALESCE(S.AuditoriumID, 1) "
+                      "WHERE S.RolledUp = 0";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            pending.push_back({sqlite3_column_int(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                               sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4),
+                               sqlite3_column_int(stmt, 5), sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7)});
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (pending.empty()) {
+        sqlite3_exec(db, "COMMIT", 0, 0, 0);
+        return;
+    }
+
+    log_info("building occupancy rollup", {{"showtimes", pending.size()}});
+    sqlite3_stmt* upsert;
+    sqlite3_stmt* mark;
+    sqlite3_prepare_v2(db, "INSERT INTO OccupancyRollup (Day, MovieID, VenueID, Showtimes, Capacity, PremiumCapacity, SeatsSold, PremiumSold, RevenueCents) "
+                           "VALUES (?, ?, ?, 1, ?, ?, ?, ?, ?) ON CONFLICT (Day, MovieID, VenueID) DO UPDATE SET "
+                           "Showtimes = Showtimes + 1, Capacity = Capacity + excluded.Capacity, "
+                           "PremiumCapacity = PremiumCapacity + excluded.PremiumCapacity, SeatsSold = SeatsSold + excluded.SeatsSold, "
+                           "PremiumSold = PremiumSold + excluded.PremiumSold, RevenueCents = RevenueCents + excluded.RevenueCents",
+                       -1, &upsert, 0);
+    sqlite3_prepare_v2(db, "UPDATE Showtimes SET RolledUp = 1 WHERE ShowtimeID = ?", -1, &mark, 0);
+    bool ok = true;
+    for (const auto& showtime : pending) {
+        SeatLayout layout;
+        load_showtime_layout(db, showtime.showtime_id, layout);
+        int sold = layout.seat_count() - showtime.seats_remaining;
+        int premium_sold = layout.premium_seat_count() - showtime.premium_remaining;
+        sqlite3_bind_text(upsert, 1, showtime.day.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(upsert, 2, showtime.movie_id);
+        sqlite3_bind_int(upsert, 3, showtime.venue_id);
+        sqlite3_bind_int(upsert, 4, layout.seat_count());
+        sqlite3_bind_int(upsert, 5, layout.premium_seat_count());
+        sqlite3_bind_int(upsert, 6, sold);
+        sqlite3_bind_int(upsert, 7, premium_sold);
+        sqlite3_bind_int64(upsert, 8, (sold - premium_sold) * showtime.normal_cents + premium_sold * showtime.premium_cents);
+        sqlite3_bind_int(mark, 1, showtime.showtime_id);
+        ok = sqlite3_step(upsert) == SQLITE_DONE && sqlite3_step(mark) == SQLITE_DONE;
+        sqlite3_reset(upsert);
+        sqlite3_reset(mark);
+        if (!ok) break;
+    }
+    sqlite3_finalize(upsert);
+    sqlite3_finalize(mark);
+    if (!ok) {
+        log_error("occupancy rollup build failed", {{"error", sqlite3_errmsg(db)}});
+        sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+        return;
+    }
+    sqlite3_exec(db, "COMMIT", 0, 0, 0);
+}
+
+// Adds a booking's seats (or takes a cancellation's off, with negative
+// counts) to the showtime's OccupancyRollup row. Runs inside the transaction
+// that books or frees them, so the rollup commits or rolls back with it. A
+// showtime not rolled up yet is left to init_occupancy_rollup().
+bool roll_up_seats(sqlite3* conn, int showtime_id, int seats, int premium)
+{
+    const char* sql = "UPDATE OccupancyRollup AS R SET SeatsSold = R.SeatsSold + ?1, PremiumSold = R.PremiumSold + ?2, "
+                      "RevenueCents = R.RevenueCents + (?1 - ?2) * CAST(ROUND(IFNULL(A.NormalPrice, 0) * 100) AS INTEGER) "
+                      "+ ?2 * CAST(ROUND(IFNULL(A.PremiumPrice, 0) * 100) AS INTEGER) "
+                      "FROM Showtimes AS S LEFT JOIN Auditoriums AS A ON A.AuditoriumID = COALESCE(S.AuditoriumID, 1) "
+                      "WHERE S.ShowtimeID = ?3 AND S.RolledUp = 1 AND R.Day = substr(S.ShowtimeDateTime, 1, 10) "
+                      "AND R.MovieID = IFNULL(S.MovieID, 0) AND R.VenueID = IFNULL(S.VenueID, 0)";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_int(stmt, 1, seats);
+    sqlite3_bind_int(stmt, 2, premium);
+    sqlite3_bind_int(stmt, 3, showtime_id);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+static bool table_exists(const char* table)
+{
+    sqlite3_stmt* stmt;
+    bool found = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?", -1, &stmt, 0) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        found = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+const int BOOKING_MIGRATION_BATCH = 500;
+
+// Databases from before BookingHeaders/BookingSeats keep one Bookings row per
+// seat, with the seat as TEXT. This copies them over BOOKING_MIGRATION_BATCH
+// rows per transaction, so other processes sharing the file (the previous
+// generation of a supervisor's workers) keep booking in between, and renames
+// the old table to Bookings_v1 in the same transaction as the last batch.
+// Copying is idempotent, so an interrupted migration simply runs again on the
+// next start and workers starting together can all run it. Bookings the old
+// processes cancelled after their rows were copied are dropped again at the
+// end. After the rename, an old process's booking fails instead of going
+// somewhere the new ones don't look.
+void migrate_legacy_bookings()
+{
+    if (!table_exists("Bookings")) return;
+    add_column_if_missing("Bookings", "OrderID", "INTEGER");
+    // Rows booked before OrderID existed: treat a user's seats for one showtime as one booking.
+    sqlite3_exec(db, "UPDATE Bookings SET OrderID = (SELECT MIN(B.BookingID) FROM Bookings AS B "
+                     "WHERE B.UserID IS Bookings.UserID AND B.ShowtimeID = Bookings.ShowtimeID) "
+                     "WHERE OrderID IS NULL", 0, 0, 0);
+    sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_bookings_user_order ON Bookings(UserID, OrderID DESC, ShowtimeID, SeatIdentifier)", 0, 0, 0);
+
+    log_info("migrating bookings to BookingSeats");
+    std::unordered_map<int, std::unique_ptr<SeatLayout>> layouts; // nullptr: showtime has no layout
+    sqlite3_int64 last_id = 0;
+    long copied = 0, skipped = 0;
+    for (bool done = false; !done;) {
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE", 0, 0, 0) != SQLITE_OK) {
+            log_error("booking migration stopped", {{"error", sqlite3_errmsg(db)}});
+            return;
+        }
+        sqlite3_stmt* rows;
+        const char* sql_rows = "SELECT BookingID, ShowtimeID, UserID, SeatIdentifier, OrderID FROM Bookings "
+                               "WHERE BookingID > ? ORDER BY BookingID LIMIT ?";
+        if (sqlite3_prepare_v2(db, sql_rows, -1, &rows, 0) != SQLITE_OK) {
+            // Another worker finished the migration first.
+            sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+            return;
+        }
+        sqlite3_bind_int64(rows, 1, last_id);
+        sqlite3_bind_int(rows, 2, BOOKING_MIGRATION_BATCH);
+        sqlite3_stmt* header;
+        sqlite3_stmt* seat;
+        sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO BookingHeaders (OrderID, ShowtimeID, UserID, CreatedAt) VALUES (?, ?, ?, NULL)", -1, &header, 0);
+        sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO BookingSeats (ShowtimeID, SeatIndex, OrderID) VALUES (?, ?, ?)", -1, &seat, 0);
+        int count = 0;
+        while (sqlite3_step(rows) == SQLITE_ROW) {
+            ++count;
+            last_id = sqlite3_column_int64(rows, 0);
+            int showtime_id = sqlite3_column_int(rows, 1);
+            const unsigned char* seat_id = sqlite3_column_text(rows, 3);
+            sqlite3_int64 order_id = sqlite3_column_int64(rows, 4);
+
+            auto layout = layouts.find(showtime_id);
+            if (layout == layouts.end()) {
+                SeatLayout loaded;
+                bool found = load_showtime_layout(db, showtime_id, loaded);
+                layout = layouts.emplace(showtime_id, found ? std::make_unique<SeatLayout>(loaded) : nullptr).first;
+            }
+            int index = layout->second && seat_id ? seat_index(*layout->second, reinterpret_cast<const char*>(seat_id)) : -1;
+            if (index < 0) {
+                ++skipped;
+                continue;
+            }
+            sqlite3_bind_int64(header, 1, order_id);
+            sqlite3_bind_int(header, 2, showtime_id);
+            if (sqlite3_column_type(rows, 2) == SQLITE_NULL) sqlite3_bind_null(header, 3);
+            else sqlite3_bind_int(header, 3, sqlite3_column_int(rows, 2));
+            sqlite3_step(header);
+            sqlite3_reset(header);
+            sqlite3_bind_int(seat, 1, showtime_id);
+            sqlite3_bind_int(seat, 2, index);
+            sqlite3_bind_int64(seat, 3, order_id);
+            sqlite3_step(seat);
+            sqlite3_reset(seat);
+            ++copied;
+        }
+        sqlite3_finalize(rows);
+        sqlite3_finalize(header);
+        sqlite3_finalize(seat);
+
+        done = count < BOOKING_MIGRATION_BATCH;
+        if (done) {
+            sqlite3_exec(db, "DELETE FROM BookingSeats WHERE OrderID IN (SELECT H.OrderID FROM BookingHeaders AS H "
+                             "WHERE H.CreatedAt IS NULL AND NOT EXISTS (SELECT 1 FROM Bookings AS B WHERE B.UserID IS H.UserID AND B.OrderID = H.OrderID))", 0, 0, 0);
+            sqlite3_exec(db, "DELETE FROM BookingHeaders WHERE CreatedAt IS NULL AND OrderID NOT IN (SELECT OrderID FROM BookingSeats)", 0, 0, 0);
+            sqlite3_exec(db, "ALTER TABLE Bookings RENAME TO Bookings_v1", 0, 0, 0);
+        }
+        if (sqlite3_exec(db, "COMMIT", 0, 0, 0) != SQLITE_OK) {
+            log_error("booking migration stopped", {{"error", sqlite3_errmsg(db)}});
+            sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+            return;
+        }
     }
-    return ss.str();
+    if (skipped) log_warning("bookings not migrated: seat not in the auditorium layout", {{"seats", skipped}});
+    log_info("bookings migrated", {{"seats", copied}});
 }
 
 void init_database() 
 {
-    if (sqlite3_open("blockmyseat.db", &db)) 
+    if (sqlite3_open(db_path.c_str(), &db)) 
     {
-        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        log_error("can't open database", {{"path", db_path}, {"error", sqlite3_errmsg(db)}});
         exit(1);
     }
+    // WAL lets the inventory shards' connections write while handlers read.
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL", 0, 0, 0);
+    sqlite3_busy_timeout(db, 5000);
+    watch_statements(db); // migrations and backfills show up in the slow-query log too
 
     const char* sql_create_table = 
         "CREATE TABLE IF NOT EXISTS Users ("
         "UserID INTEGER PRIMARY KEY AUTOINCREMENT,"
         "Username TEXT UNIQUE NOT NULL,"
         "Email TEXT UNIQUE NOT NULL,"
-        "Password TEXT NOT NULL);";
+        "Password TEXT NOT NULL,"
         "SessionToken TEXT);";
 
     char* zErrMsg = 0;
     if (sqlite3_exec(db, sql_create_table, 0, 0, &zErrMsg) != SQLITE_OK) 
     {
-        std::cerr << "SQL error: " << zErrMsg << std::endl;
+        log_error("schema setup failed", {{"step", "Users"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
 
@@ -68,7 +519,7 @@ void init_database()
 
     if (sqlite3_exec(db, sql_create_movies, 0, 0, &zErrMsg) != SQLITE_OK) 
     {
-        std::cerr << "SQL error (Movies): " << zErrMsg << std::endl;
+        log_error("schema setup failed", {{"step", "Movies"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
     const char* sql_create_venues =
@@ -78,9 +529,11 @@ void init_database()
         "Location TEXT,"
         "ImageURL TEXT,"
         "AuditoriumCount INTEGER,"
-        "Rating REAL);";
+        "Rating REAL,"
+        "Latitude REAL,"
+        "Longitude REAL);";
     if (sqlite3_exec(db, sql_create_venues, 0, 0, &zErrMsg) != SQLITE_OK) {
-        std::cerr << "SQL error (Venues): " << zErrMsg << std::endl;
+        log_error("schema setup failed", {{"step", "Venues"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
 
@@ -91,11 +544,15 @@ void init_database()
         "VenueID INTEGER,"
         "AuditoriumID INTEGER," // <-- ADDED THIS COLUMN
         "ShowtimeDateTime TEXT NOT NULL,"
+        "SeatsRemaining INTEGER,"   // maintained by /book-tickets, see init_seat_counters()
+        "PremiumRemaining INTEGER,"
+        "SeatsSeq INTEGER NOT NULL DEFAULT 0," // +1 per booking or cancellation, see seat_snapshot.hpp
+        "RolledUp INTEGER NOT NULL DEFAULT 0," // 1 once counted in OccupancyRollup, see init_occupancy_rollup()
         "FOREIGN KEY(MovieID) REFERENCES Movies(MovieID),"
         "FOREIGN KEY(VenueID) REFERENCES Venues(VenueID),"
         "FOREIGN KEY(AuditoriumID) REFERENCES Auditoriums(AuditoriumID));";
     if (sqlite3_exec(db, sql_create_showtimes, 0, 0, &zErrMsg) != SQLITE_OK) {
-        std::cerr << "SQL error (Showtimes): " << zErrMsg << std::endl;
+        log_error("schema setup failed", {{"step", "Showtimes"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
 
@@ -109,21 +566,161 @@ void init_database()
         "PremiumPrice REAL,"
         "FOREIGN KEY(VenueID) REFERENCES Venues(VenueID));"; // <-- REMOVED Rating column
     if (sqlite3_exec(db, sql_create_auditoriums, 0, 0, &zErrMsg) != SQLITE_OK) {
-        std::cerr << "SQL error (Auditoriums): " << zErrMsg << std::endl;
+        log_error("schema setup failed", {{"step", "Auditoriums"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
-    const char* sql_create_bookings =
-        "CREATE TABLE IF NOT EXISTS Bookings ("
-        "BookingID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "ShowtimeID INTEGER,"
-        "UserID INTEGER," // <-- ADDED THIS COLUMN
-        "SeatIdentifier TEXT NOT NULL,"
+    // One row per booking; its OrderID is the booking_id clients see.
+    const char* sql_create_booking_headers =
+        "CREATE TABLE IF NOT EXISTS BookingHeaders ("
+        "OrderID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "ShowtimeID INTEGER NOT NULL,"
+        "UserID INTEGER,"
+        "CreatedAt TEXT DEFAULT CURRENT_TIMESTAMP," // NULL for bookings copied from the old Bookings table
         "FOREIGN KEY(ShowtimeID) REFERENCES Showtimes(ShowtimeID),"
         "FOREIGN KEY(UserID) REFERENCES Users(UserID));";
-    if (sqlite3_exec(db, sql_create_bookings, 0, 0, &zErrMsg) != SQLITE_OK) {
-        std::cerr << "SQL error (Bookings): " << zErrMsg << std::endl;
+    if (sqlite3_exec(db, sql_create_booking_headers, 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "BookingHeaders"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    // One row per booked seat, clustered by showtime: loading a showtime's
+    // occupancy is a single range of the primary key, and the key itself is
+    // the last line of defence against double booking when several server
+    // processes (each with its own seat state) share this database.
+    // SeatIndex is row * seats_per_row + (seat number - 1) in the auditorium's
+    // layout, see seat_index() in seat_layout.hpp.
+    const char* sql_create_booking_seats =
+        "CREATE TABLE IF NOT EXISTS BookingSeats ("
+        "ShowtimeID INTEGER NOT NULL,"
+        "SeatIndex INTEGER NOT NULL,"
+        "OrderID INTEGER NOT NULL REFERENCES BookingHeaders(OrderID),"
+        "PRIMARY KEY (ShowtimeID, SeatIndex)) WITHOUT ROWID;";
+    if (sqlite3_exec(db, sql_create_booking_seats, 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "BookingSeats"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    // Seats sold and revenue per day, movie and venue, kept up to date by the
+    // booking and cancellation transactions so /analytics never has to group
+    // the bookings themselves. RevenueCents uses the auditorium's prices.
+    const char* sql_create_occupancy_rollup =
+        "CREATE TABLE IF NOT EXISTS OccupancyRollup ("
+        "Day TEXT NOT NULL,"
+        "MovieID INTEGER NOT NULL,"
+        "VenueID INTEGER NOT NULL,"
+        "Showtimes INTEGER NOT NULL DEFAULT 0,"
+        "Capacity INTEGER NOT NULL DEFAULT 0,"
+        "PremiumCapacity INTEGER NOT NULL DEFAULT 0,"
+        "SeatsSold INTEGER NOT NULL DEFAULT 0,"
+        "PremiumSold INTEGER NOT NULL DEFAULT 0,"
+        "RevenueCents INTEGER NOT NULL DEFAULT 0,"
+        "PRIMARY KEY (Day, MovieID, VenueID)) WITHOUT ROWID;";
+    if (sqlite3_exec(db, sql_create_occupancy_rollup, 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "OccupancyRollup"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    // Keys are the client's, so they are only unique per user.
+    const std::string sql_create_idempotency =
+        "CREATE TABLE IF NOT EXISTS IdempotencyKeys ("
+        "UserID INTEGER NOT NULL,"
+        "IdempotencyKey TEXT NOT NULL,"
+        "RequestFingerprint TEXT NOT NULL,"
+        "ResponseCode INTEGER NOT NULL,"
+        "ResponseBody TEXT NOT NULL,"
+        "CreatedAt TEXT DEFAULT CURRENT_TIMESTAMP,"
+        "PRIMARY KEY (UserID, IdempotencyKey));";
+    if (sqlite3_exec(db, sql_create_idempotency.c_str(), 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "IdempotencyKeys"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+    // Databases from before keys were per user: rebuild the table, taking the
+    // user from the fingerprint ("<showtime>:<user>:<seats>"). Checked again
+    // under the write lock in case another worker got there first.
+    if (!column_exists("IdempotencyKeys", "UserID") && sqlite3_exec(db, "BEGIN IMMEDIATE", 0, 0, 0) == SQLITE_OK) {
+        bool migrated = column_exists("IdempotencyKeys", "UserID");
+        if (!migrated) {
+            std::string sql_migrate_idempotency =
+                "ALTER TABLE IdempotencyKeys RENAME TO IdempotencyKeysGlobal;"
+                "DROP INDEX IF EXISTS idx_idempotency_created;" +
+                sql_create_idempotency +
+                "INSERT OR IGNORE INTO IdempotencyKeys "
+                "SELECT CAST(substr(F, 1, instr(F, ':') - 1) AS INTEGER), IdempotencyKey, RequestFingerprint, ResponseCode, ResponseBody, CreatedAt "
+                "FROM (SELECT *, substr(RequestFingerprint, instr(RequestFingerprint, ':') + 1) AS F FROM IdempotencyKeysGlobal);"
+                "DROP TABLE IdempotencyKeysGlobal;";
+            migrated = sqlite3_exec(db, sql_migrate_idempotency.c_str(), 0, 0, &zErrMsg) == SQLITE_OK;
+            if (!migrated) {
+                log_error("schema setup failed", {{"step", "IdempotencyKeys per user"}, {"error", zErrMsg}});
+                sqlite3_free(zErrMsg);
+            }
+        }
+        sqlite3_exec(db, migrated ? "COMMIT" : "ROLLBACK", 0, 0, 0);
+    }
+    // Lets each keyed booking purge the expired keys with a range scan.
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_idempotency_created ON IdempotencyKeys(CreatedAt)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "IdempotencyKeys created index"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    // A user's bookings newest first (history), and a booking's seats (history, cancellation).
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_booking_headers_user ON BookingHeaders(UserID, OrderID DESC)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "BookingHeaders user index"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_booking_seats_order ON BookingSeats(OrderID)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "BookingSeats order index"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+    // A SeatIndex means a seat only under the layout it was booked in, so a
+    // showtime's seat geometry is pinned once it has bookings: its auditorium's
+    // sections can't change, and it can't move to another auditorium.
+    const char* sql_pin_layouts =
+        "CREATE TRIGGER IF NOT EXISTS auditorium_sections_pinned BEFORE UPDATE OF Layout ON Auditoriums "
+        "WHEN (CASE WHEN json_valid(NEW.Layout) THEN json_extract(NEW.Layout, '$.sections') END) IS NOT "
+        "(CASE WHEN json_valid(OLD.Layout) THEN json_extract(OLD.Layout, '$.sections') END) "
+        "AND EXISTS (SELECT 1 FROM Showtimes AS S JOIN BookingSeats AS B ON B.ShowtimeID = S.ShowtimeID "
+        "WHERE COALESCE(S.AuditoriumID, 1) = OLD.AuditoriumID) "
+        "BEGIN SELECT RAISE(ABORT, 'auditorium sections are pinned by existing bookings'); END;"
+        "CREATE TRIGGER IF NOT EXISTS showtime_auditorium_pinned BEFORE UPDATE OF AuditoriumID ON Showtimes "
+        "WHEN COALESCE(NEW.AuditoriumID, 1) IS NOT COALESCE(OLD.AuditoriumID, 1) "
+        "AND EXISTS (SELECT 1 FROM BookingSeats WHERE ShowtimeID = OLD.ShowtimeID) "
+        "BEGIN SELECT RAISE(ABORT, 'a showtime with bookings keeps its auditorium'); END;";
+    if (sqlite3_exec(db, sql_pin_layouts, 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "seat layout triggers"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    // Serves the per-day and per-week showtime lookups as range scans.
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_showtimes_movie_time ON Showtimes(MovieID, ShowtimeDateTime)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "Showtimes movie index"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_showtimes_venue_time ON Showtimes(VenueID, ShowtimeDateTime)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "Showtimes venue index"}, {"error", zErrMsg}});
+        sqlite3_free(zErrMsg);
+    }
+
+    add_column_if_missing("Showtimes", "SeatsRemaining", "INTEGER");
+    add_column_if_missing("Showtimes", "PremiumRemaining", "INTEGER");
+    add_column_if_missing("Showtimes", "SeatsSeq", "INTEGER NOT NULL DEFAULT 0");
+    add_column_if_missing("Showtimes", "RolledUp", "INTEGER NOT NULL DEFAULT 0");
+    add_column_if_missing("Venues", "Latitude", "REAL");
+    add_column_if_missing("Venues", "Longitude", "REAL");
+    // Coordinates for the seeded venues in databases created before the columns existed.
+    sqlite3_exec(db, "UPDATE Venues SET "
+                     "Latitude = CASE VenueID WHEN 1 THEN 12.9716 WHEN 2 THEN 13.035 WHEN 3 THEN 12.9352 WHEN 4 THEN 12.9698 WHEN 5 THEN 12.9141 WHEN 6 THEN 13.0067 WHEN 7 THEN 12.8456 WHEN 8 THEN 12.9784 WHEN 9 THEN 13.1007 END, "
+                     "Longitude = CASE VenueID WHEN 1 THEN 77.5946 WHEN 2 THEN 77.597 WHEN 3 THEN 77.6245 WHEN 4 THEN 77.75 WHEN 5 THEN 77.6101 WHEN 6 THEN 77.5713 WHEN 7 THEN 77.6603 WHEN 8 THEN 77.6408 WHEN 9 THEN 77.5963 END "
+                     "WHERE Latitude IS NULL AND VenueID <= 9", 0, 0, 0);
+    add_column_if_missing("Users", "SessionToken", "TEXT");
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_users_session_token ON Users(SessionToken)", 0, 0, &zErrMsg) != SQLITE_OK) {
+        log_error("schema setup failed", {{"step", "Users token index"}, {"error", zErrMsg}});
         sqlite3_free(zErrMsg);
     }
+    // Older layouts don't carry their row count; these match the table hard-coded in seats.js.
+    sqlite3_exec(db, "UPDATE Auditoriums SET Layout = json_set(Layout, '$.total_rows', "
+                     "CASE AuditoriumID WHEN 2 THEN 10 WHEN 3 THEN 9 ELSE 8 END) "
+                     "WHERE json_extract(Layout, '$.total_rows') IS NULL", 0, 0, 0);
 
 
     // SEEDING FAKE DATA FOR TESTING
@@ -132,58 +729,58 @@ void init_database()
 
     if (movie_count == 0) 
     {
-        std::cout << "Movies table is empty. Seeding with initial data..." << std::endl;
+        log_info("seeding empty table", {{"table", "Movies"}});
         const char* seed_sql =
             "INSERT INTO Movies (Title, PosterURL, Synopsis, DurationMinutes, Rating) VALUES "
             "('The Crimson Shadow', 'crimson shadow.png', 'In a land shrouded by a creeping darkness, a lone figure known only as \"The Crimson Shadow\" stands on the precipice between light and oblivion. Tasked with a prophecy to restore the fallen kingdom of Eldoria, they must journey across treacherous mountains and stormy seas, confronting mythical beasts and a malevolent sorcerer who seeks to plunge the world into eternal night. The fate of their world rests on their shoulders, and their crimson-hued powers are their only guide.', 120, 'PG-13'),"
             "('Echoes of Neptune', 'echos of neptune.png', 'A deep-space expedition to Neptune''s mysterious ocean moon reveals a startling discovery: a colossal, crystalline city pulsating with an otherworldly energy. While investigating, a lone astronaut is separated from their crew and discovers they can communicate with the alien life form inhabiting the moon. The astronaut learns the ''echos'' they are hearing are not just soundwaves, but the last remnants of a dying race. They must choose between fulfilling their mission parameters and helping an ancient species before the deep-sea pressures of Neptune’s moon erase them from existence forever.', 95, 'PG-13'),"
-            "('Galactic Drift', 'galactic drift.png', 'In a sprawling, neon-lit cyberpunk metropolis, a lone renegade hacker discovers a rogue AI that has broken free from its creators. Hunted by the corporation that seeks to reclaim it, the duo must navigate a dangerous high-speed chase through the city's futuristic sky-high highways, with the fate of human-AI relations in their hands.', 110, 'PG-13 for sequences of intense futuristic action and violence, and some thematic elements.'),"
-            "('Midnight Cipher', 'midnight cipher.png', 'A gritty private eye is hired to retrieve a glowing, encrypted briefcase in a rain-soaked, neon-lit city. He finds himself embroiled in a conspiracy far deadlier than a simple theft, as ruthless assassins and a shadowy organization hunt him for the cipher he now possesses. To survive, he must decode its secrets before the city's midnight hour.', 135, 'R for strong violence, language, and some sexual content.'),"
+            "('Galactic Drift', 'galactic drift.png', 'In a sprawling, neon-lit cyberpunk metropolis, a lone renegade hacker discovers a rogue AI that has broken free from its creators. Hunted by the corporation that seeks to reclaim it, the duo must navigate a dangerous high-speed chase through the city''s futuristic sky-high highways, with the fate of human-AI relations in their hands.', 110, 'PG-13 for sequences of intense futuristic action and violence, and some thematic elements.'),"
+            "('Midnight Cipher', 'midnight cipher.png', 'A gritty private eye is hired to retrieve a glowing, encrypted briefcase in a rain-soaked, neon-lit city. He finds himself embroiled in a conspiracy far deadlier than a simple theft, as ruthless assassins and a shadowy organization hunt him for the cipher he now possesses. To survive, he must decode its secrets before the city''s midnight hour.', 135, 'R for strong violence, language, and some sexual content.'),"
             "('The Last Starlight', 'the laststarlight.png', 'In the last moments of a dying universe, a lone astronaut embarks on a desperate journey to find a mythical cosmic anomaly—a \"last starlight\" that can reignite creation. As he traverses desolate, forgotten worlds, he must confront his own solitude and the philosophical weight of his mission, knowing that his success or failure will determine the fate of everything that has ever been.', 105, 'PG'),"
-            "('Forgotten City of Zorg', 'forgotten city of zorg.png', 'A rugged archaeologist ventures into a mysterious, overgrown jungle in search of the legendary Forgotten City of Zorg. He discovers a colossal, ruined city with strange, alien-like geometric patterns, hinting at a lost civilization. He must navigate the city's treacherous ruins and decode its secrets to uncover the truth of its ancient inhabitants.', 105, 'PG'),"
-            "('Cybernetic Dawn', 'cybernetic dawn.png', 'In a dystopian future where humanity is enhanced with cybernetic technology, a group of rebels with advanced modifications rises up against the tyrannical corporations that control them. As the sun rises on a new day, they must fight their way through the city's futuristic skyline to spark a revolution and reclaim their freedom.', 105, 'PG-13'),"
+            "('Forgotten City of Zorg', 'forgotten city of zorg.png', 'A rugged archaeologist ventures into a mysterious, overgrown jungle in search of the legendary Forgotten City of Zorg. He discovers a colossal, ruined city with strange, alien-like geometric patterns, hinting at a lost civilization. He must navigate the city''s treacherous ruins and decode its secrets to uncover the truth of its ancient inhabitants.', 105, 'PG'),"
+            "('Cybernetic Dawn', 'cybernetic dawn.png', 'In a dystopian future where humanity is enhanced with cybernetic technology, a group of rebels with advanced modifications rises up against the tyrannical corporations that control them. As the sun rises on a new day, they must fight their way through the city''s futuristic skyline to spark a revolution and reclaim their freedom.', 105, 'PG-13'),"
             "('Project Chimera', 'project chimera.png', 'A brilliant but reckless scientist embarks on a forbidden experiment to create monstrous, chimeric creatures by fusing the DNA of different animals. As his creations break free and wreak havoc, he must find a way to stop them before his project destroys the world.', 105, 'PG-13'),"
             "('Quantum Bloom', 'quantum bloom.png', 'A lone explorer discovers a hidden portal that leads to a vibrant, otherworldly dimension. They enter to find a breathtaking landscape filled with glowing, fantastical flowers and plants. They must navigate this strange, beautiful world to uncover the source of its incredible power, but they soon discover that this beauty hides a dangerous secret.', 105, 'PG'),"
-            "('Solaris Rising', 'solaris rising.png', 'Humanity's last hope rests in a colossal, solar-powered space station that is orbiting a dying star. A small crew on the station must find a way to reignite the star, or they will be plunged into a cosmic cold darkness, ending the human race for good.', 105, 'PG'),"
-            "('The Alchemist's Secret', 'the alchemists secret.png', 'An alchemist discovers the legendary secret to creating a new type of element. This new substance is said to have the power to create a new, better world, but a powerful, shadowy organization wants to use its power for destruction. The alchemist must protect his secret at all costs before it falls into the wrong hands.', 105, 'PG'),"
-            "('Warden of the Void', 'warden of the void.png', 'A lone, heavily-armored warrior is the Warden of the Void, a guardian of the universe's most dangerous prison: a massive, swirling black vortex in deep space. He must face down a malevolent, otherworldly force that is trying to escape from the vortex, using his wits and weaponry to protect the universe from a cosmic threat.', 105, 'PG-13'),"
+            "('Solaris Rising', 'solaris rising.png', 'Humanity''s last hope rests in a colossal, solar-powered space station that is orbiting a dying star. A small crew on the station must find a way to reignite the star, or they will be plunged into a cosmic cold darkness, ending the human race for good.', 105, 'PG'),"
+            "('The Alchemist''s Secret', 'the alchemists secret.png', 'An alchemist discovers the legendary secret to creating a new type of element. This new substance is said to have the power to create a new, better world, but a powerful, shadowy organization wants to use its power for destruction. The alchemist must protect his secret at all costs before it falls into the wrong hands.', 105, 'PG'),"
+            "('Warden of the Void', 'warden of the void.png', 'A lone, heavily-armored warrior is the Warden of the Void, a guardian of the universe''s most dangerous prison: a massive, swirling black vortex in deep space. He must face down a malevolent, otherworldly force that is trying to escape from the vortex, using his wits and weaponry to protect the universe from a cosmic threat.', 105, 'PG-13'),"
             "('Chrono Heist', 'chrono heist.png', 'A master thief in a futuristic city is tasked with stealing a valuable historical artifact from a highly secure museum. He discovers that the artifact is a temporal device, and as he tries to steal it, he finds himself in a high-stakes, time-bending heist where he must navigate holographic displays of historical events and a constantly changing reality to escape and prevent a temporal paradox.', 105, 'PG-13'),"
-            "('Neon Serpent', 'neon serpent.png', 'In a futuristic, cyberpunk city, a mysterious, glowing, neon-colored serpent appears in the city's rain-soaked streets. As it slithers through the city's alleyways, it leaves a trail of destruction in its wake. A lone detective must track down the serpent and uncover its origins to prevent it from destroying the city.', 105, 'PG-13'),"
-            "('Oracle of the Dunes', 'oracle of the dunes.png', 'A lone wanderer braves a desolate, sand-swept world to find the legendary Oracle, said to reside within a colossal, ancient temple carved from the desert itself. As colossal sandstorms loom, they must uncover the secrets of the shifting landscape and face the trials of the desert to hear the Oracle's prophecy, which promises to change their world forever.', 105, 'PG'),"
-            "('Titan's Fall', 'titans fall.png', 'In a world where colossal mechanical gods once roamed, an expedition team discovers a long-lost titan, now overgrown and dormant in a misty valley. As they explore its immense, silent form, they uncover the secrets of its catastrophic downfall, only to realize that their presence has awakened something far older and more dangerous than they could have imagined.', 105, 'PG-13'),"
+            "('Neon Serpent', 'neon serpent.png', 'In a futuristic, cyberpunk city, a mysterious, glowing, neon-colored serpent appears in the city''s rain-soaked streets. As it slithers through the city''s alleyways, it leaves a trail of destruction in its wake. A lone detective must track down the serpent and uncover its origins to prevent it from destroying the city.', 105, 'PG-13'),"
+            "('Oracle of the Dunes', 'oracle of the dunes.png', 'A lone wanderer braves a desolate, sand-swept world to find the legendary Oracle, said to reside within a colossal, ancient temple carved from the desert itself. As colossal sandstorms loom, they must uncover the secrets of the shifting landscape and face the trials of the desert to hear the Oracle''s prophecy, which promises to change their world forever.', 105, 'PG'),"
+            "('Titan''s Fall', 'titans fall.png', 'In a world where colossal mechanical gods once roamed, an expedition team discovers a long-lost titan, now overgrown and dormant in a misty valley. As they explore its immense, silent form, they uncover the secrets of its catastrophic downfall, only to realize that their presence has awakened something far older and more dangerous than they could have imagined.', 105, 'PG-13'),"
             "('Aetherium Wars', 'aetherium wars.png', 'The sky-high conflict between two warring floating cities, one a kingdom of arcane magic and the other a bastion of industrial science, reaches a fever pitch. As their grand airships and fantastical weapons clash in the heavens, a hero from each side must race against time to expose a hidden conspiracy that threatens to bring both their civilizations crashing down.', 105, 'PG'),"
             "('Rogue Singularity', 'rogue singularity.png', 'When a maverick pilot on a reconnaissance mission stumbles upon a chaotic temporal anomaly, their advanced starship is drawn into a maelstrom of cosmic energy and shattered realities. They must fight against the impossible forces of the singularity to find a way back home, navigating a field of swirling debris and twisted spacetime.', 105, 'PG-13'),"
-            "('Whispers of the Deep', 'whispers of the deep.png', 'A submarine crew on a deep-sea mining expedition makes a chilling discovery. When their sonar picks up an unknown signal, they descend into the ocean's darkest abyss, only to find themselves stalked by a monstrous, ancient creature from beyond the light. Trapped in the crushing darkness, they must find a way to escape before the terrifying whispers of the deep claim their sanity.', 105, 'PG-13'),"
-            "('The Gilded Compass', 'the glided compass.png', 'In a world where clockwork marvels and steampunk contraptions power civilization, a skilled adventurer comes into possession of a mystical, gilded compass that points not to true north, but to the location of a legendary hidden city. Pursued by a ruthless corporate guild, they must decipher the compass's secrets and navigate a treacherous world of automatons, airships, and grand contraptions.', 105, 'PG'),"
+            "('Whispers of the Deep', 'whispers of the deep.png', 'A submarine crew on a deep-sea mining expedition makes a chilling discovery. When their sonar picks up an unknown signal, they descend into the ocean''s darkest abyss, only to find themselves stalked by a monstrous, ancient creature from beyond the light. Trapped in the crushing darkness, they must find a way to escape before the terrifying whispers of the deep claim their sanity.', 105, 'PG-13'),"
+            "('The Gilded Compass', 'the glided compass.png', 'In a world where clockwork marvels and steampunk contraptions power civilization, a skilled adventurer comes into possession of a mystical, gilded compass that points not to true north, but to the location of a legendary hidden city. Pursued by a ruthless corporate guild, they must decipher the compass''s secrets and navigate a treacherous world of automatons, airships, and grand contraptions.', 105, 'PG'),"
             "('Zero Point Anomaly', 'zero point anomaly.png', 'In a high-security research facility, a team of brilliant but reckless scientists successfully creates a stable temporal anomaly. But their groundbreaking discovery quickly spirals out of control, revealing that the anomaly is not just a scientific breakthrough but a portal to another dimension. They must contain the anomaly and prevent its catastrophic effects from bleeding into their reality.', 105, 'PG-13'),"
-            "('Siren's Lament', 'sirens lament.png', 'On a dark and stormy night, a grieving sailor is lured to a treacherous shipwreck by the haunting song of a spectral siren. As a furious storm rages, he must resist her enchanting call, for the whispers promise to reunite him with his lost love. He must face the truth of her beautiful lie and escape the Siren's embrace before he is lost to the sea forever.', 105, 'PG-13'),"
-            "('Dragon's Gambit', 'dragons gambit.png', 'The land is at the mercy of a fearsome dragon, and the last remaining kingdom makes a desperate final move. The most skilled knight is sent on a perilous quest to challenge the dragon and its colossal might, standing on a misty mountaintop as the sun sets, ready for the final, legendary battle that will determine the fate of their world.', 105, 'PG'),"
-            "('The Starforged Blade', 'the starforged blade.png', 'As a cataclysmic war rages in the cosmos, a lonely warrior discovers a legendary sword on a distant, icy mountaintop. Forged from the very stars themselves, the blade grants them immense power, and with it, they are humanity's last hope. They must wield the blade to face down an unstoppable enemy and bring an end to the celestial conflict.', 105, 'PG-13'),"
-            "('Nomad of the Wastes', 'nomad of the wastes.png', 'In a sun-scorched, post-apocalyptic wasteland, a lone survivor travels across vast, sand-swept dunes with a battered vehicle. Hunted by a relentless storm of sand and scavengers, they must use their wits and combat skills to survive the unforgiving landscape, holding on to a secret that could change the fate of what's left of humanity.', 105, 'PG-13'),"
-            "('Crimson Peak Legacy', 'crimson peak legacy.png', 'In a desolate, mist-shrouded mountain, a young woman inherits a crumbling, gothic mansion from a long-lost relative. As she explores its labyrinthine halls, she discovers that the mansion is home to more than just dust and cobwebs—it is haunted by a malevolent, crimson-colored entity that is connected to her family's past. She must unravel the chilling mystery before it's too late.', 105, 'PG-13'),"
+            "('Siren''s Lament', 'sirens lament.png', 'On a dark and stormy night, a grieving sailor is lured to a treacherous shipwreck by the haunting song of a spectral siren. As a furious storm rages, he must resist her enchanting call, for the whispers promise to reunite him with his lost love. He must face the truth of her beautiful lie and escape the Siren''s embrace before he is lost to the sea forever.', 105, 'PG-13'),"
+            "('Dragon''s Gambit', 'dragons gambit.png', 'The land is at the mercy of a fearsome dragon, and the last remaining kingdom makes a desperate final move. The most skilled knight is sent on a perilous quest to challenge the dragon and its colossal might, standing on a misty mountaintop as the sun sets, ready for the final, legendary battle that will determine the fate of their world.', 105, 'PG'),"
+            "('The Starforged Blade', 'the starforged blade.png', 'As a cataclysmic war rages in the cosmos, a lonely warrior discovers a legendary sword on a distant, icy mountaintop. Forged from the very stars themselves, the blade grants them immense power, and with it, they are humanity''s last hope. They must wield the blade to face down an unstoppable enemy and bring an end to the celestial conflict.', 105, 'PG-13'),"
+            "('Nomad of the Wastes', 'nomad of the wastes.png', 'In a sun-scorched, post-apocalyptic wasteland, a lone survivor travels across vast, sand-swept dunes with a battered vehicle. Hunted by a relentless storm of sand and scavengers, they must use their wits and combat skills to survive the unforgiving landscape, holding on to a secret that could change the fate of what''s left of humanity.', 105, 'PG-13'),"
+            "('Crimson Peak Legacy', 'crimson peak legacy.png', 'In a desolate, mist-shrouded mountain, a young woman inherits a crumbling, gothic mansion from a long-lost relative. As she explores its labyrinthine halls, she discovers that the mansion is home to more than just dust and cobwebs—it is haunted by a malevolent, crimson-colored entity that is connected to her family''s past. She must unravel the chilling mystery before it''s too late.', 105, 'PG-13'),"
             "('The Ghost Fleet', 'the ghost flet.png', 'A seasoned sailor on a quiet night at sea stumbles upon a terrifying sight: a fleet of ghostly, transparent ships emerges from a thick fog, their presence chilling the water to a dead calm. He must use his skills to outmaneuver the spectral armada and break free from their eerie supernatural pull before his own ship joins the ranks of the ghost fleet.', 105, 'PG'),"
-            "('Ironclad Heart', 'ironclad heart.png', 'In a dystopian future ruled by corporate war, a battle-worn mech warrior is the last line of defense for a rebellion. Powered by a mysterious, glowing heart, the mech must fight its way through a ruined metropolis, confronting the city's ruthless robotic enforcers to deliver a message of hope to the surviving citizens.', 105, 'PG-13'),"
+            "('Ironclad Heart', 'ironclad heart.png', 'In a dystopian future ruled by corporate war, a battle-worn mech warrior is the last line of defense for a rebellion. Powered by a mysterious, glowing heart, the mech must fight its way through a ruined metropolis, confronting the city''s ruthless robotic enforcers to deliver a message of hope to the surviving citizens.', 105, 'PG-13'),"
             "('Sands of Fury', 'sands of fury.png', 'In a world consumed by an endless desert, a lone warrior on a futuristic armored bike races against a colossal, ever-expanding sandstorm. Pursued by both the forces of nature and a gang of ruthless raiders, they must navigate the treacherous landscape and find a legendary oasis that holds the key to the survival of humanity.', 105, 'PG-13'),"
             "('The Celestial Map', 'the celestial map.png', 'An astronomer at a remote observatory discovers that the constellations are not just patterns of light but a cosmic map left behind by a celestial intelligence. As he deciphers its riddles, he realizes that the map is a guide to a new world. He must now protect the map from forces that want to exploit its power and embark on a journey of galactic proportions.', 105, 'PG'),"
-            "('Vanguard's Oath', 'vanguards oath.png', 'In a world where magic and machinery have merged, a legendary armored warrior known as the Vanguard faces the ultimate test. They stand as the sole guardian of humanity, confronting a formidable, corrupted dragon-like creature that has laid waste to the land. After a final, devastating battle, the Vanguard must uphold their solemn oath to protect what remains and rebuild their world.', 105, 'PG-13'),"
+            "('Vanguard''s Oath', 'vanguards oath.png', 'In a world where magic and machinery have merged, a legendary armored warrior known as the Vanguard faces the ultimate test. They stand as the sole guardian of humanity, confronting a formidable, corrupted dragon-like creature that has laid waste to the land. After a final, devastating battle, the Vanguard must uphold their solemn oath to protect what remains and rebuild their world.', 105, 'PG-13'),"
             "('Shadow of the Colossus', 'shadow of the colossus.png', 'In a world of colossal, slumbering giants, a lone swordsman embarks on a forbidden journey to revive his lost love. His quest requires him to awaken and defeat the ancient stone colossi that roam the land, but as he fights each one, he discovers a horrifying truth about their connection to the land and his own destiny.', 105, 'PG-13'),"
             "('The Emerald Tablet', 'the emarald tablet.png', 'A resourceful explorer ventures deep into a lost temple, where legend says the secrets of alchemy are hidden. After navigating treacherous traps and puzzles, she discovers the fabled Emerald Tablet, which glows with an arcane energy. But a shadowy syndicate is close behind her, and she must use her wits to escape with the tablet, its secrets promising to change the course of science and magic.', 105, 'PG'),"
             "('Rebel of the Red Planet', 'rebel of the red planet.png', 'In a Martian colony controlled by a tyrannical corporation, a lone rebel soldier uncovers a conspiracy that threatens to enslave all of humanity. He must fight his way across the desolate red planet, battling ruthless corporate forces while seeking a way to transmit his discovery to Earth. He is a symbol of hope for a future free from oppression.', 105, 'PG-13'),"
-            "('The Sunken Kingdom', 'the sunken kingdom.png', 'In a future where the oceans have reclaimed the land, a deep-sea explorer follows a cryptic signal to the bottom of the ocean. He discovers the mythical, technologically advanced kingdom of Atlantis, still pulsing with a faint light. He must navigate the city's treacherous ruins and decipher its secrets, discovering a dark truth about its fall and the forces that still haunt it.', 105, 'PG'),"
+            "('The Sunken Kingdom', 'the sunken kingdom.png', 'In a future where the oceans have reclaimed the land, a deep-sea explorer follows a cryptic signal to the bottom of the ocean. He discovers the mythical, technologically advanced kingdom of Atlantis, still pulsing with a faint light. He must navigate the city''s treacherous ruins and decipher its secrets, discovering a dark truth about its fall and the forces that still haunt it.', 105, 'PG'),"
             "('Path of the Ronin', 'path of robin.png', 'A masterless samurai, disgraced by a past he cannot escape, wanders through a mystical land of spirits and treacherous forests. Haunted by his past failures, he seeks to atone for his sins, facing spiritual battles and internal demons along a misty path, with a single goal: to find a place of peace, or a worthy end.', 105, 'PG-13'),"
-            "('The Clockwork Conspiracy', 'the clockwork conspiracy.png', 'In a sprawling, steampunk metropolis, a cynical private detective is hired to investigate a string of murders linked to an intricate clockwork device. The trail leads him into a hidden world of brilliant but dangerous inventors and a conspiracy to control the city's power with a sinister clockwork contraption. He must solve the mystery before the city's time runs out.', 105, 'PG-13'),"
-            "('Legacy of the Void', 'legacy of the void.png', 'A lone pilot on a scavenging mission in deep space discovers a derelict, ancient space station. Upon boarding, he finds that the station holds the last remnants of a forgotten civilization and a powerful secret. As he uncovers the truth of their downfall, he realizes that the same fate awaits him if he can't escape the station and its haunting legacy.', 105, 'PG'),"
+            "('The Clockwork Conspiracy', 'the clockwork conspiracy.png', 'In a sprawling, steampunk metropolis, a cynical private detective is hired to investigate a string of murders linked to an intricate clockwork device. The trail leads him into a hidden world of brilliant but dangerous inventors and a conspiracy to control the city''s power with a sinister clockwork contraption. He must solve the mystery before the city''s time runs out.', 105, 'PG-13'),"
+            "('Legacy of the Void', 'legacy of the void.png', 'A lone pilot on a scavenging mission in deep space discovers a derelict, ancient space station. Upon boarding, he finds that the station holds the last remnants of a forgotten civilization and a powerful secret. As he uncovers the truth of their downfall, he realizes that the same fate awaits him if he can''t escape the station and its haunting legacy.', 105, 'PG'),"
             "('The Obsidian Mirror', 'the obsidian mirror.png', 'An antiquarian acquires an ornate, ancient obsidian mirror with a dark reputation. When he looks into its depths, he discovers that the mirror is a gateway to a terrifying other-dimensional realm. As a malevolent entity from the other side tries to break through, he must find a way to destroy the mirror before its dark reflection consumes his world.', 105, 'PG-13'),"
-            "('Whispering Woods', 'whispering woods.png', 'A young traveler, seeking a missing sibling, enters an enchanted forest where the trees themselves seem to watch and whisper. As she ventures deeper, she discovers the woods are home to ancient spirits, some benevolent and some sinister. She must navigate the forest's magical puzzles and face the truth of its hidden mysteries to find her missing sibling.', 105, 'PG'),"
+            "('Whispering Woods', 'whispering woods.png', 'A young traveler, seeking a missing sibling, enters an enchanted forest where the trees themselves seem to watch and whisper. As she ventures deeper, she discovers the woods are home to ancient spirits, some benevolent and some sinister. She must navigate the forest''s magical puzzles and face the truth of its hidden mysteries to find her missing sibling.', 105, 'PG'),"
             "('The Final Frontier', 'the final fromtier.png', 'After a devastating war, a lone, battle-worn pilot on a mission of exploration discovers a wormhole-like portal in the farthest reaches of space. He decides to enter the portal, embarking on a dangerous journey to an unknown destination, hoping to find a new world for humanity and leave behind the broken universe he knows.', 105, 'PG'),"
             "('Guardians of the Gate', 'guardians of the gate.png', 'A powerful, magical gate stands as the only barrier between two dimensions—one of light and one of darkness. Two elite guardians, bound by an ancient oath, must defend the gate against a malevolent force seeking to cross into their world. With their swords and magic, they are the last line of defense in a war between realms.', 105, 'PG-13'),"
             "('The Last Spell', 'the last spell.png', 'After a devastating battle, a lone sorcerer is all that stands between a magical kingdom and an invading army. With his allies defeated and his power nearly depleted, he must use the last of his strength to cast a final, forbidden spell that could either save his world or destroy it.', 105, 'PG-13'),"
-            "('The Frozen Throne', 'the frozen throne.png', 'In a world covered in a perpetual blizzard, a young warrior embarks on a quest to defeat the tyrannical ruler who sits on the Frozen Throne. The warrior must brave the punishing snowstorms and treacherous icy lands to reach the throne room and challenge the figure who holds a dark secret about the world's endless winter.', 105, 'PG-13'),"
-            "('The Serpent's Kiss', 'the serpants kiss.png', 'A young woman seeks a cure for her village's mysterious illness and is told of a mystical serpent in a forgotten swamp. She travels to the swamp and finds the serpent, which promises to heal her people in exchange for her soul. She must choose between the well-being of her village and her own life.', 105, 'PG-13');";
+            "('The Frozen Throne', 'the frozen throne.png', 'In a world covered in a perpetual blizzard, a young warrior embarks on a quest to defeat the tyrannical ruler who sits on the Frozen Throne. The warrior must brave the punishing snowstorms and treacherous icy lands to reach the throne room and challenge the figure who holds a dark secret about the world''s endless winter.', 105, 'PG-13'),"
+            "('The Serpent''s Kiss', 'the serpants kiss.png', 'A young woman seeks a cure for her village''s mysterious illness and is told of a mystical serpent in a forgotten swamp. She travels to the swamp and finds the serpent, which promises to heal her people in exchange for her soul. She must choose between the well-being of her village and her own life.', 105, 'PG-13');";
 
         if (sqlite3_exec(db, seed_sql, 0, 0, &zErrMsg) != SQLITE_OK) 
         {
-            std::cerr << "SQL error (Seeding): " << zErrMsg << std::endl;
+            log_error("seeding failed", {{"table", "Movies"}, {"error", zErrMsg}});
             sqlite3_free(zErrMsg);
         }
     }
@@ -193,21 +790,21 @@ void init_database()
     int venue_count = 0;
     sqlite3_exec(db, "SELECT COUNT(*) FROM Venues", callback_is_empty, &venue_count, &zErrMsg);
     if (venue_count == 0) {
-        std::cout << "Venues table is empty. Seeding..." << std::endl;
+        log_info("seeding empty table", {{"table", "Venues"}});
         const char* seed_sql =
-            "INSERT INTO Venues (Name, Location, ImageURL, AuditoriumCount, Rating) VALUES "
-            "('Blocky Multiplex', 'Downtown Cubeville', 'images/blocky multiplex.png', 12, 4.5),"
-            "('The Redstone Cinema', 'Oak Valley', 'images/the redstone cinema.png', 8, 5.0),"
-            "('Pixel Perfect Theaters', 'Glass Pane City', 'images/pixel perfect.png', 16, 4.0),"
-            "('The Redstone Reel', 'Block City', 'images/the redstone reel.png', 5, 4.6),"
-            "('Creeper Cinemas', 'Creeperville', 'images/creeper cinemas.png', 7, 4.4),"
-            "('The Ender Screen', 'Endertown', 'images/the ender screen.png', 6, 4.7),"
-            "('NetherFlix Theatre', 'Nether District', 'images/netherflix.png', 8, 4.5),"
-            "('Diamond Screenplex', 'Minecart Central', 'images/diamond screenplex.png', 10, 4.8),"
-            "('Blockbuster Pavilion', 'Craftsville', 'images/blockbuster pavilion.png', 4, 4.3);";
+            "INSERT INTO Venues (Name, Location, ImageURL, AuditoriumCount, Rating, Latitude, Longitude) VALUES "
+            "('Blocky Multiplex', 'Downtown Cubeville', 'images/blocky multiplex.png', 12, 4.5, 12.9716, 77.5946),"
+            "('The Redstone Cinema', 'Oak Valley', 'images/the redstone cinema.png', 8, 5.0, 13.035, 77.597),"
+            "('Pixel Perfect Theaters', 'Glass Pane City', 'images/pixel perfect.png', 16, 4.0, 12.9352, 77.6245),"
+            "('The Redstone Reel', 'Block City', 'images/the redstone reel.png', 5, 4.6, 12.9698, 77.75),"
+            "('Creeper Cinemas', 'Creeperville', 'images/creeper cinemas.png', 7, 4.4, 12.9141, 77.6101),"
+            "('The Ender Screen', 'Endertown', 'images/the ender screen.png', 6, 4.7, 13.0067, 77.5713),"
+            "('NetherFlix Theatre', 'Nether District', 'images/netherflix.png', 8, 4.5, 12.8456, 77.6603),"
+            "('Diamond Screenplex', 'Minecart Central', 'images/diamond screenplex.png', 10, 4.8, 12.9784, 77.6408),"
+            "('Blockbuster Pavilion', 'Craftsville', 'images/blockbuster pavilion.png', 4, 4.3, 13.1007, 77.5963);";
 
         if (sqlite3_exec(db, seed_sql, 0, 0, &zErrMsg) != SQLITE_OK) {
-            std::cerr << "SQL error (Seeding Venues): " << zErrMsg << std::endl;
+            log_error("seeding failed", {{"table", "Venues"}, {"error", zErrMsg}});
             sqlite3_free(zErrMsg);
         }
     }
@@ -216,7 +813,7 @@ void init_database()
     sqlite3_exec(db, "SELECT COUNT(*) FROM Showtimes", callback_is_empty, &showtime_count, &zErrMsg);
     
     if (showtime_count == 0) {
-        std::cout << "Showtimes table is empty. Seeding with initial data..." << std::endl;
+        log_info("seeding empty table", {{"table", "Showtimes"}});
         // Let's create showtimes for today (e.g., 2025-08-22)
         const char* seed_sql =
             "INSERT INTO Showtimes (MovieID, VenueID, ShowtimeDateTime) VALUES "
@@ -235,7 +832,7 @@ void init_database()
             "(2, 5, '2025-08-23 19:30:00'), (3, 6, '2025-08-23 21:45:00');";
         
         if (sqlite3_exec(db, seed_sql, 0, 0, &zErrMsg) != SQLITE_OK) {
-            std::cerr << "SQL error (Seeding Showtimes): " << zErrMsg << std::endl;
+            log_error("seeding failed", {{"table", "Showtimes"}, {"error", zErrMsg}});
             sqlite3_free(zErrMsg);
         }
     }
@@ -243,17 +840,17 @@ void init_database()
     int auditorium_count = 0;
     sqlite3_exec(db, "SELECT COUNT(*) FROM Auditoriums", callback_is_empty, &auditorium_count, &zErrMsg);
     if (auditorium_count == 0) {
-        std::cout << "Auditoriums table is empty. Seeding..." << std::endl;
+        log_info("seeding empty table", {{"table", "Auditoriums"}});
         const char* seed_sql =
             "INSERT INTO Auditoriums (VenueID, AuditoriumNumber, Layout, NormalPrice, PremiumPrice) VALUES "
             // Venue 1, Audi 1 (2 sections, 2 premium rows)
-            "(1, 1, '{\"sections\":[10, 10], \"premium_rows\":2}', 10.50, 15.50),"
+            "(1, 1, '{\"sections\":[10, 10], \"premium_rows\":2, \"total_rows\":8}', 10.50, 15.50),"
             // Venue 1, Audi 2 (3 sections, 1 premium row)
-            "(1, 2, '{\"sections\":[8, 12, 8], \"premium_rows\":1}', 10.50, 15.50),"
+            "(1, 2, '{\"sections\":[8, 12, 8], \"premium_rows\":1, \"total_rows\":10}', 10.50, 15.50),"
             // Venue 2, Audi 1 (1 section, 1 premium row)
-            "(2, 1, '{\"sections\":[20], \"premium_rows\":1}', 12.00, 18.00);";
+            "(2, 1, '{\"sections\":[20], \"premium_rows\":1, \"total_rows\":9}', 12.00, 18.00);";
         if (sqlite3_exec(db, seed_sql, 0, 0, &zErrMsg) != SQLITE_OK) {
-            std::cerr << "SQL error (Seeding Auditoriums): " << zErrMsg << std::endl;
+            log_error("seeding failed", {{"table", "Auditoriums"}, {"error", zErrMsg}});
             sqlite3_free(zErrMsg);
         }
     }
@@ -261,311 +858,2163 @@ void init_database()
      
     else 
     {
-        std::cout << "Database is ready." << std::endl;
+        log_info("database is ready");
     }
 
+    migrate_legacy_bookings();
+    init_seat_counters();
+    init_occupancy_rollup();
 }
 
-int main() 
-{
-    init_database();
-
-    // Declare the app with the CORS middleware directly in the template.
-    crow::App<crow::CORSHandler> app;
-
-    // Get a reference to the CORS middleware and configure it.
-    auto& cors = app.get_middleware<crow::CORSHandler>();
-    // A simple policy: allow all origins, all methods, all headers.
-    cors
-    .global()
-    .headers("Content-Type") // Allow the frontend to specify the content type
-    .methods("POST"_method, "GET"_method, "OPTIONS"_method) // Allow these HTTP methods
-    .origin("*"); // Allow any origin (including file://)
+// Cached /book-tickets responses keyed by the user and the client's
+// Idempotency-Key header (see idempotency_cache_key()). Successful bookings
+// are written to IdempotencyKeys inside the booking transaction, so a retry
+// after a restart, or on another worker, is still recognised; only responses
+// that agree with that table are kept here, so every worker answers a key
+// the same way. Keys are kept for a day: each keyed booking deletes the ones
+// older than that, after which the key can be used again.
+IdempotencyCache idempotency_cache(10000, std::chrono::hours(24));
 
-    // --- Define your routes ---
-    CROW_ROUTE(app, "/signup").methods("POST"_method)
-    ([](const crow::request& req)
-    {
-        auto j = json::parse(req.body);
-        std::string username = j["username"];
-        std::string email = j["email"];
-        std::string password = j["password"];
+std::string idempotency_cache_key(int user_id, const std::string& key) { return std::to_string(user_id) + ":" + key; }
 
-        sqlite3_stmt* stmt;
-        const char* sql_check = "SELECT UserID FROM Users WHERE Username = ? OR Email = ?";
-        sqlite3_prepare_v2(db, sql_check, -1, &stmt, 0);
-        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_STATIC);
+// Whether `response` is what IdempotencyKeys says for its key: a committed
+// booking, or a key already used for a different one.
+bool idempotency_persisted(const StoredResponse& response) { return response.code == 200 || response.code == 422; }
 
-        if (sqlite3_step(stmt) == SQLITE_ROW) 
-        {
-            sqlite3_finalize(stmt);
-            return crow::response(409, json{{"status", "error"}, {"message", "Username or email already taken."}}.dump());
+bool load_idempotent_response(sqlite3* conn, int user_id, const std::string& key, const std::string& fingerprint, StoredResponse& stored)
+{
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT RequestFingerprint, ResponseCode, ResponseBody FROM IdempotencyKeys "
+                      "WHERE UserID = ? AND IdempotencyKey = ? AND CreatedAt > datetime('now', '-1 day')";
+    bool found = false;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_text(stmt, 2, key.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            found = true;
+            if (fingerprint != reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) {
+                stored = {422, json{{"status", "error"}, {"message", "Idempotency-Key was already used for a different booking."}}.dump()};
+            } else {
+                stored = {sqlite3_column_int(stmt, 1), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))};
+            }
         }
-        sqlite3_finalize(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
 
-        const char* sql_insert = "INSERT INTO Users (Username, Email, Password) VALUES (?, ?, ?)";
-        sqlite3_prepare_v2(db, sql_insert, -1, &stmt, 0);
-        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, password.c_str(), -1, SQLITE_STATIC);
+// Books all of `seats` or none of them. Runs on the shard that owns the
+// showtime: the seats are claimed in memory straight away, so later requests
+// in the same batch see them taken, and `reply` fires once the shard's batch
+// transaction has committed (or the claim was rolled back).
+void book_seats(InventoryShard& shard, int showtimeId, int userId, const std::vector<std::string>& seats,
+                const std::string& hold_id, const std::string& idempotency_key, const std::string& fingerprint,
+                std::function<void(StoredResponse)> reply)
+{
+    ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+    if (!showtime) {
+        reply({404, "Showtime not found"});
+        return;
+    }
 
-        if (sqlite3_step(stmt) != SQLITE_DONE) 
-        {
-            sqlite3_finalize(stmt);
-            return crow::response(500, json{{"status", "error"}, {"message", "Failed to create user."}}.dump());
+    std::vector<int> seat_indices;
+    int premium_booked = 0;
+    for (const auto& seat_id : seats) {
+        int index = showtime->seat_index(seat_id);
+        if (index < 0 || std::find(seat_indices.begin(), seat_indices.end(), index) != seat_indices.end()) {
+            reply({400, json{{"status", "error"}, {"message", "Invalid seat " + seat_id + "."}}.dump()});
+            return;
         }
-        sqlite3_finalize(stmt);
+        if (!showtime->is_available(index, hold_id)) {
+            reply({409, json{{"status", "error"}, {"message", "One or more seats are no longer available."}}.dump()});
+            return;
+        }
+        seat_indices.push_back(index);
+        if (showtime->is_premium(index)) premium_booked++;
+    }
 
-        return crow::response(201, json{{"status", "success"}, {"message", "Account created successfully."}}.dump());
-    });
+    for (int index : seat_indices) showtime->set_booked(index, true);
+    showtime->release_hold(hold_id);
 
-     CROW_ROUTE(app, "/login").methods("POST"_method)
-    ([](const crow::request& req){
-        auto j = json::parse(req.body);
-        std::string username = j["username"];
-        std::string password = j["password"];
+    // Filled in once the booking's OrderID is known, inside the transaction.
+    auto success_body = std::make_shared<std::string>();
+    // Set when another server process booked one of the seats first (the
+    // BookingSeats primary key rejects the insert).
+    auto conflict = std::make_shared<bool>(false);
+    auto movie_id = std::make_shared<int>(0);
+    // Set when the key was committed by another worker since this one looked.
+    auto replayed = std::make_shared<StoredResponse>();
 
+    ShardWrite write;
+    // The seat rows, the showtime's remaining-seat counters and the idempotency
+    // record commit together.
+    write.apply = [=](sqlite3* conn) {
         sqlite3_stmt* stmt;
-        const char* sql_select = "SELECT UserID, Password FROM Users WHERE Username = ?";
-        
-        if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) != SQLITE_OK) {
-            return crow::response(500, "DB error");
+        if (!idempotency_key.empty()) {
+            // The batch holds the write lock, so no other worker can commit the
+            // key between this check and the insert below.
+            if (sqlite3_exec(conn, "DELETE FROM IdempotencyKeys WHERE CreatedAt <= datetime('now', '-1 day')", 0, 0, 0) != SQLITE_OK) {
+                log_error("idempotency key purge failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+                return false;
+            }
+            if (load_idempotent_response(conn, userId, idempotency_key, fingerprint, *replayed)) return false;
         }
-        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
 
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            int userId = sqlite3_column_int(stmt, 0);
-            std::string password_from_db = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            
-            if (password == password_from_db) {
-                sqlite3_finalize(stmt);
-                std::string token = generate_session_token();
-                
-                // Store token in DB
-                const char* sql_update = "UPDATE Users SET SessionToken = ? WHERE UserID = ?";
-                sqlite3_prepare_v2(db, sql_update, -1, &stmt, 0);
-                sqlite3_bind_text(stmt, 1, token.c_str(), -1, SQLITE_STATIC);
-                sqlite3_bind_int(stmt, 2, userId);
-                sqlite3_step(stmt);
-                sqlite3_finalize(stmt);
+        sqlite3_prepare_v2(conn, "INSERT INTO BookingHeaders (ShowtimeID, UserID) VALUES (?, ?)", -1, &stmt, 0);
+        sqlite3_bind_int(stmt, 1, showtimeId);
+        sqlite3_bind_int(stmt, 2, userId);
+        bool inserted = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        if (!inserted) {
+            log_error("booking insert failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+            return false;
+        }
+        sqlite3_int64 order_id = sqlite3_last_insert_rowid(conn);
 
-                json res_json;
-                res_json["status"] = "success";
-                res_json["message"] = "Login successful!";
-                res_json["token"] = token;
-                res_json["userId"] = userId;
-                return crow::response(200, res_json.dump());
+        sqlite3_prepare_v2(conn, "INSERT INTO BookingSeats (ShowtimeID, SeatIndex, OrderID) VALUES (?, ?, ?)", -1, &stmt, 0);
+        for (int index : seat_indices) {
+            sqlite3_bind_int(stmt, 1, showtimeId);
+            sqlite3_bind_int(stmt, 2, index);
+            sqlite3_bind_int64(stmt, 3, order_id);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                *conflict = sqlite3_errcode(conn) == SQLITE_CONSTRAINT;
+                if (!*conflict) log_error("booking insert failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+                sqlite3_finalize(stmt);
+                return false;
             }
+            sqlite3_reset(stmt);
         }
-        
         sqlite3_finalize(stmt);
-        return crow::response(401, json{{"status", "error"}, {"message", "Invalid username or password."}}.dump());
-    });
-    CROW_ROUTE(app, "/movies").methods("GET"_method)
-    ([]()
-    {
-        json movies_json = json::array();
-        sqlite3_stmt* stmt;
-        const char* sql_select = "SELECT MovieID, Title, PosterURL, Synopsis, DurationMinutes, Rating FROM Movies";
+        *success_body = json{{"status", "success"}, {"message", "Booking confirmed!"}, {"booking_id", order_id}}.dump();
 
-        if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) 
-        {
-            while (sqlite3_step(stmt) == SQLITE_ROW) 
-            {
-                json movie;
-                movie["id"] = sqlite3_column_int(stmt, 0);
-                movie["title"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                movie["poster_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-                movie["synopsis"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-                movie["duration_minutes"] = sqlite3_column_int(stmt, 4);
-                movie["rating"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-                movies_json.push_back(movie);
+        if (!idempotency_key.empty()) {
+            const char* sql_key = "INSERT INTO IdempotencyKeys (UserID, IdempotencyKey, RequestFingerprint, ResponseCode, ResponseBody) "
+                                  "VALUES (?, ?, ?, 200, ?)";
+            sqlite3_prepare_v2(conn, sql_key, -1, &stmt, 0);
+            sqlite3_bind_int(stmt, 1, userId);
+            sqlite3_bind_text(stmt, 2, idempotency_key.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, fingerprint.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 4, success_body->c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                log_error("idempotency key insert failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+                sqlite3_finalize(stmt);
+                return false;
             }
+            sqlite3_finalize(stmt);
+        }
+
+        const char* sql_counters = "UPDATE Showtimes SET SeatsRemaining = SeatsRemaining - ?, "
+                                   "PremiumRemaining = PremiumRemaining - ?, SeatsSeq = SeatsSeq + 1 WHERE ShowtimeID = ? "
+                                   "RETURNING MovieID";
+        sqlite3_prepare_v2(conn, sql_counters, -1, &stmt, 0);
+        sqlite3_bind_int(stmt, 1, static_cast<int>(seats.size()));
+        sqlite3_bind_int(stmt, 2, premium_booked);
+        sqlite3_bind_int(stmt, 3, showtimeId);
+        bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+        if (ok) {
+            *movie_id = sqlite3_column_int(stmt, 0);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
         }
+        if (!ok) log_error("booking counters update failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
         sqlite3_finalize(stmt);
+        if (ok && !roll_up_seats(conn, showtimeId, static_cast<int>(seats.size()), premium_booked)) {
+            log_error("occupancy rollup update failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+            return false;
+        }
+        return ok;
+    };
+    write.done = [=, &shard](bool committed) {
+        if (committed) {
+            trending.record(*movie_id, showtimeId, static_cast<uint32_t>(seat_indices.size()));
+            reply({200, *success_body});
+            return;
+        }
+        // Give the seats back; the showtime is still owned by this shard, but
+        // a failed refresh may have dropped it, and its next load is correct.
+        ShowtimeSeats* seats_state = shard.showtime(showtimeId);
+        if (seats_state) {
+            for (int index : seat_indices) seats_state->set_booked(index, false);
+        }
+        if (replayed->code != 0) {
+            reply(*replayed);
+            return;
+        }
+        if (*conflict) {
+            shard.reload(showtimeId);
+            reply({409, json{{"status", "error"}, {"message", "One or more seats are no longer available."}}.dump()});
+            return;
+        }
+        reply({500, "Failed to book one or more seats."});
+    };
+    write.showtime_id = showtimeId;
+    shard.queue_write(std::move(write));
+}
 
-        return crow::response(200, movies_json.dump());
-    });
+// Runs on the shard owning showtimeId. Deletes the booking and its seat rows and
+// gives the seats back to the showtime counters in one write, then frees them
+// in memory so the next request can book them. `seats` are the rows the
+// caller found for the booking; if another cancellation got there first the
+// delete finds fewer rows and nothing is released.
+void cancel_seats(InventoryShard& shard, int showtimeId, sqlite3_int64 order_id, int userId,
+                  const std::vector<std::string>& seats, std::function<void(StoredResponse)> reply)
+{
+    ShowtimeSeats* showtime = shard.showtime(showtimeId);
+    if (!showtime) {
+        reply({404, json{{"status", "error"}, {"message", "Showtime not found."}}.dump()});
+        return;
+    }
+    std::vector<int> seat_indices;
+    int premium_released = 0;
+    for (const auto& seat_id : seats) {
+        int index = showtime->seat_index(seat_id);
+        if (index < 0) continue;
+        seat_indices.push_back(index);
+        if (showtime->is_premium(index)) premium_released++;
+    }
 
-    CROW_ROUTE(app, "/venues").methods("GET"_method)
-    ([](){
-        json venues_json = json::array();
+    auto gone = std::make_shared<bool>(false);
+    ShardWrite write;
+    write.apply = [=](sqlite3* conn) {
         sqlite3_stmt* stmt;
-        const char* sql_select = "SELECT VenueID, Name, Location, ImageURL, AuditoriumCount FROM Venues";
-
-        if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) 
-        {
-            while (sqlite3_step(stmt) == SQLITE_ROW) 
-            {
-                json venue;
-                venue["id"] = sqlite3_column_int(stmt, 0);
-                venue["name"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                venue["location"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-                venue["image_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-                venue["auditorium_count"] = sqlite3_column_int(stmt, 4);
-                venues_json.push_back(venue);
-            }
-        }
+        sqlite3_prepare_v2(conn, "DELETE FROM BookingHeaders WHERE OrderID = ? AND UserID = ?", -1, &stmt, 0);
+        sqlite3_bind_int64(stmt, 1, order_id);
+        sqlite3_bind_int(stmt, 2, userId);
+        bool ok = sqlite3_step(stmt) == SQLITE_DONE;
         sqlite3_finalize(stmt);
+        if (ok && sqlite3_changes(conn) != 1) {
+            *gone = true;
+            return false;
+        }
+        if (ok) {
+            sqlite3_prepare_v2(conn, "DELETE FROM BookingSeats WHERE OrderID = ?", -1, &stmt, 0);
+            sqlite3_bind_int64(stmt, 1, order_id);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_finalize(stmt);
+        }
+        if (!ok) {
+            log_error("cancel delete failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"order_id", order_id}, {"error", sqlite3_errmsg(conn)}});
+            return false;
+        }
+        if (sqlite3_changes(conn) != static_cast<int>(seats.size())) {
+            *gone = true;
+            return false;
+        }
 
-        return crow::response(200, venues_json.dump());
-    });
-    CROW_ROUTE(app, "/movies/<int>")
-([](int movieID){
-    json movie_json;
-    sqlite3_stmt* stmt;
-    const char* sql_select = "SELECT MovieID, Title, PosterURL, Synopsis, DurationMinutes, Rating FROM Movies WHERE MovieID = ?";
-
-    if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) {
-        sqlite3_bind_int(stmt, 1, movieID);
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            movie_json["id"] = sqlite3_column_int(stmt, 0);
-            movie_json["title"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            movie_json["poster_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-            movie_json["synopsis"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-            movie_json["duration_minutes"] = sqlite3_column_int(stmt, 4);
-            movie_json["rating"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        const char* sql_counters = "UPDATE Showtimes SET SeatsRemaining = SeatsRemaining + ?, "
+                                   "PremiumRemaining = PremiumRemaining + ?, SeatsSeq = SeatsSeq + 1 WHERE ShowtimeID = ?";
+        sqlite3_prepare_v2(conn, sql_counters, -1, &stmt, 0);
+        sqlite3_bind_int(stmt, 1, static_cast<int>(seats.size()));
+        sqlite3_bind_int(stmt, 2, premium_released);
+        sqlite3_bind_int(stmt, 3, showtimeId);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        if (!ok) log_error("cancel counters update failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+        sqlite3_finalize(stmt);
+        if (ok && !roll_up_seats(conn, showtimeId, -static_cast<int>(seats.size()), -premium_released)) {
+            log_error("occupancy rollup update failed", {{"showtime_id", showtimeId}, {"user_id", userId}, {"error", sqlite3_errmsg(conn)}});
+            return false;
         }
-    }
-    sqlite3_finalize(stmt);
+        return ok;
+    };
+    write.done = [=, &shard](bool committed) {
+        if (!committed) {
+            if (*gone) reply({409, json{{"status", "error"}, {"message", "This booking was already cancelled."}}.dump()});
+            else reply({500, "Failed to cancel the booking."});
+            return;
+        }
+        ShowtimeSeats* seats_state = shard.showtime(showtimeId);
+        if (seats_state) {
+            for (int index : seat_indices) seats_state->set_booked(index, false);
+        }
+        shard.seats_released(showtimeId, seat_indices);
+        reply({200, json{{"status", "success"}, {"message", "Booking cancelled."}, {"booking_id", order_id}, {"seats", seats}}.dump()});
+    };
+    write.showtime_id = showtimeId;
+    shard.queue_write(std::move(write));
+}
 
-    if (movie_json.is_null()) {
-        return crow::response(404, "Movie not found");
-    }
-    return crow::response(200, movie_json.dump());
-});
+// Read endpoints hit hardest when a trailer drops. Concurrent identical
+// requests share one query, and the body is reused for a short while after.
+// Failures (including a full DB queue) go to the waiters but aren't cached.
+auto cacheable_response = [](const StoredResponse& r) { return r.code < 500; };
+SingleFlight<StoredResponse> showtimes_flight(std::chrono::milliseconds(500), cacheable_response);
+SingleFlight<StoredResponse> occupied_seats_flight(std::chrono::milliseconds(200), cacheable_response);
 
-// === NEW ENDPOINT 2: Get showtimes for a movie on a specific date ===
-CROW_ROUTE(app, "/showtimes")
-([](const crow::request& req){
-    auto movie_id_str = req.url_params.get("movie_id");
-    auto date_str = req.url_params.get("date");
+std::string occupied_seats_key(int showtime_id)
+{
+    return "occupied:" + std::to_string(showtime_id);
+}
 
-    if (!movie_id_str || !date_str) {
-        return crow::response(400, "Missing movie_id or date parameter");
-    }
+// A movie's showtimes are cached a week at a time, each week read with one
+// range scan over idx_showtimes_movie_time. /showtimes/batch answers a date
+// strip from at most two of these per movie. Seat counts in here can lag a
+// booking by up to the TTL; the seat map itself is always live.
+TtlCache<std::shared_ptr<const MovieWeek>> movie_weeks(std::chrono::seconds(2), 1024);
+const int MAX_BATCH_MOVIES = 20;
+const int MAX_BATCH_DAYS = 31;
+
+std::shared_ptr<const MovieWeek> load_movie_week(sqlite3* conn, int movie_id, int first_day)
+{
+    std::string key = "week:" + std::to_string(movie_id) + ":" + std::to_string(first_day);
+    std::shared_ptr<const MovieWeek> cached;
+    if (movie_weeks.get(key, cached)) return cached;
 
-    // This SQL query is now correct because V.Rating exists.
-    std::string sql = "SELECT V.VenueID, V.Name, V.Rating, V.ImageURL, strftime('%H:%M', S.ShowtimeDateTime), S.ShowtimeID, S.AuditoriumID "
+    const char* sql = "SELECT S.ShowtimeID, S.VenueID, V.Name, V.Rating, V.ImageURL, substr(S.ShowtimeDateTime, 1, 10), "
+                      "strftime('%H:%M', S.ShowtimeDateTime), S.AuditoriumID, S.SeatsRemaining, S.PremiumRemaining, V.Location "
                       "FROM Showtimes AS S JOIN Venues AS V ON S.VenueID = V.VenueID "
-                      "WHERE S.MovieID = ? AND S.ShowtimeDateTime LIKE ? || '%' "
-                      "ORDER BY V.VenueID, S.ShowtimeDateTime";
-    
+                      "WHERE S.MovieID = ? AND S.ShowtimeDateTime >= ? AND S.ShowtimeDateTime < ?";
     sqlite3_stmt* stmt;
-    json venues_with_showtimes = json::object();
-    int rc;
-
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
-        std::cerr << "SQL PREPARE ERROR: " << sqlite3_errmsg(db) << std::endl;
-        return crow::response(500, "Database query preparation failed");
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) != SQLITE_OK) {
+        log_error("movie week prepare failed", {{"movie_id", movie_id}, {"error", sqlite3_errmsg(conn)}});
+        return nullptr;
     }
+    std::string from = format_date(first_day), to = format_date(first_day + 7);
+    sqlite3_bind_int(stmt, 1, movie_id);
+    sqlite3_bind_text(stmt, 2, from.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, to.c_str(), -1, SQLITE_STATIC);
 
-    sqlite3_bind_int(stmt, 1, std::stoi(movie_id_str));
-    sqlite3_bind_text(stmt, 2, date_str, -1, SQLITE_STATIC);
-
+    auto text = [stmt](int col) {
+        const unsigned char* value = sqlite3_column_text(stmt, col);
+        return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    };
+    auto week = std::make_shared<MovieWeek>();
+    week->movie_id = movie_id;
+    week->first_day = first_day;
+    int rc;
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        int venue_id = sqlite3_column_int(stmt, 0);
-        std::string venue_id_key = std::to_string(venue_id);
+        ScheduledShowtime showtime;
+        showtime.showtime_id = sqlite3_column_int(stmt, 0);
+        showtime.movie_id = movie_id;
+        showtime.venue_id = sqlite3_column_int(stmt, 1);
+        if (!parse_date(text(5), showtime.day)) continue;
+        showtime.time = text(6);
+        showtime.auditorium_id = sqlite3_column_int(stmt, 7);
+        showtime.seats_remaining = sqlite3_column_int(stmt, 8);
+        showtime.premium_remaining = sqlite3_column_int(stmt, 9);
+        week->showtimes.push_back(showtime);
 
-        if (venues_with_showtimes.find(venue_id_key) == venues_with_showtimes.end()) {
-            venues_with_showtimes[venue_id_key]["venue_id"] = venue_id;
-            venues_with_showtimes[venue_id_key]["venue_name"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            venues_with_showtimes[venue_id_key]["venue_rating"] = sqlite3_column_double(stmt, 2);
-            venues_with_showtimes[venue_id_key]["venue_image_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-            venues_with_showtimes[venue_id_key]["showtimes"] = json::array();
-        }
-        
-        json showtime_obj;
-        showtime_obj["time"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        showtime_obj["showtime_id"] = sqlite3_column_int(stmt, 5);
-        showtime_obj["auditorium_id"] = sqlite3_column_int(stmt, 6);
-
-        venues_with_showtimes[venue_id_key]["showtimes"].push_back(showtime_obj);
+        bool known = false;
+        for (const auto& venue : week->venues) known = known || venue.venue_id == showtime.venue_id;
+        if (!known) week->venues.push_back({showtime.venue_id, text(2), sqlite3_column_double(stmt, 3), text(4), text(10)});
     }
-
+    sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
-        std::cerr << "SQL EXECUTION ERROR: " << sqlite3_errmsg(db) << std::endl;
+        log_error("movie week query failed", {{"movie_id", movie_id}, {"error", sqlite3_errmsg(conn)}});
+        return nullptr;
     }
 
-    sqlite3_finalize(stmt);
+    std::sort(week->showtimes.begin(), week->showtimes.end(), [](const ScheduledShowtime& a, const ScheduledShowtime& b) {
+        if (a.day != b.day) return a.day < b.day;
+        if (a.venue_id != b.venue_id) return a.venue_id < b.venue_id;
+        return a.time < b.time;
+    });
+    movie_weeks.put(key, week);
+    return week;
+}
 
-    json final_response = json::array();
-    for (auto& el : venues_with_showtimes.items()) {
-        final_response.push_back(el.value());
+// Parses "1,2,3" into ids; false on anything malformed.
+bool parse_id_list(const std::string& text, std::vector<int>& ids)
+{
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty() || item.size() > 9 || item.find_first_not_of("0123456789") != std::string::npos) return false;
+        ids.push_back(std::stoi(item));
     }
+    return !ids.empty();
+}
 
-    return crow::response(200, final_response.dump());
-});
-CROW_ROUTE(app, "/auditorium-details/<int>")
-    ([](int auditoriumId){
-        json audi_json;
+// Query parameter `name` as a whole integer of type T; left as it is when the
+// parameter is absent. False when it is present but not exactly a number in
+// T's range ("abc", "5x", "" and "99999999999" for an int all fail).
+template <typename T>
+bool int_param(const crow::request& req, const char* name, T& value)
+{
+    const char* text = req.url_params.get(name);
+    if (!text) return true;
+    const char* end = text + std::strlen(text);
+    T parsed;
+    auto result = std::from_chars(text, end, parsed);
+    if (result.ec != std::errc() || result.ptr != end || result.ptr == text) return false;
+    value = parsed;
+    return true;
+}
+
+// Same for a finite decimal number.
+bool number_param(const crow::request& req, const char* name, double& value)
+{
+    const char* text = req.url_params.get(name);
+    if (!text) return true;
+    char* end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)) return false;
+    value = parsed;
+    return true;
+}
+
+// Snapshot of Movies and Venues, reloaded at most once a minute (or when a
+// lookup misses, in case a row was added since).
+TtlCache<std::shared_ptr<const Catalog>> catalog_cache(std::chrono::seconds(60), 1);
+
+std::shared_ptr<const Catalog> load_catalog(sqlite3* conn, bool force_reload = false)
+{
+    std::shared_ptr<const Catalog> cached;
+    if (!force_reload && catalog_cache.get("catalog", cached)) return cached;
+
+    auto catalog = std::make_shared<Catalog>();
+    auto text = [](sqlite3_stmt* stmt, int col) {
+        const unsigned char* value = sqlite3_column_text(stmt, col);
+        return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    };
+    sqlite3_stmt* stmt;
+    int rc;
+    if (sqlite3_prepare_v2(conn, "SELECT MovieID, Title, PosterURL, DurationMinutes, Rating FROM Movies", -1, &stmt, 0) != SQLITE_OK) return nullptr;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        catalog->movies[id] = {id, text(stmt, 1), text(stmt, 2), sqlite3_column_int(stmt, 3), text(stmt, 4)};
+    }
+    sqlite3_finalize(stmt);
+    // An interrupted or failed scan must not be cached as the whole catalog.
+    if (rc != SQLITE_DONE) return nullptr;
+
+    if (sqlite3_prepare_v2(conn, "SELECT VenueID, Name, Rating, ImageURL, Location, Latitude, Longitude FROM Venues", -1, &stmt, 0) != SQLITE_OK) return nullptr;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        VenueSummary venue{id, text(stmt, 1), sqlite3_column_double(stmt, 2), text(stmt, 3), text(stmt, 4)};
+        if (sqlite3_column_type(stmt, 5) != SQLITE_NULL && sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+            venue.has_coordinates = true;
+            venue.latitude = sqlite3_column_double(stmt, 5);
+            venue.longitude = sqlite3_column_double(stmt, 6);
+            catalog->venue_grid.insert(id, venue.latitude, venue.longitude);
+        }
+        catalog->venues[id] = venue;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return nullptr;
+
+    catalog_cache.put("catalog", catalog);
+    return catalog;
+}
+
+// A venue's whole schedule, read in index order over idx_showtimes_venue_time.
+// Same short TTL as movie_weeks since it carries the seat counters too.
+TtlCache<std::shared_ptr<const VenueSchedule>> venue_schedules(std::chrono::seconds(2), 1024);
+const int MAX_SCHEDULE_DAYS = 14;
+const double MAX_NEARBY_RADIUS_KM = 100;
+
+std::shared_ptr<const VenueSchedule> load_venue_schedule(sqlite3* conn, int venue_id)
+{
+    std::string key = std::to_string(venue_id);
+    std::shared_ptr<const VenueSchedule> cached;
+    if (venue_schedules.get(key, cached)) return cached;
+
+    const char* sql = "SELECT ShowtimeID, MovieID, AuditoriumID, substr(ShowtimeDateTime, 1, 10), strftime('%H:%M', ShowtimeDateTime), "
+                      "SeatsRemaining, PremiumRemaining "
+                      "FROM Showtimes WHERE VenueID = ? ORDER BY ShowtimeDateTime";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) != SQLITE_OK) {
+        log_error("venue schedule prepare failed", {{"venue_id", venue_id}, {"error", sqlite3_errmsg(conn)}});
+        return nullptr;
+    }
+    sqlite3_bind_int(stmt, 1, venue_id);
+
+    auto schedule = std::make_shared<VenueSchedule>();
+    schedule->venue_id = venue_id;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ScheduledShowtime showtime;
+        const unsigned char* date = sqlite3_column_text(stmt, 3);
+        const unsigned char* time = sqlite3_column_text(stmt, 4);
+        if (!date || !time || !parse_date(reinterpret_cast<const char*>(date), showtime.day)) continue;
+        showtime.showtime_id = sqlite3_column_int(stmt, 0);
+        showtime.movie_id = sqlite3_column_int(stmt, 1);
+        showtime.venue_id = venue_id;
+        showtime.auditorium_id = sqlite3_column_int(stmt, 2);
+        showtime.time = reinterpret_cast<const char*>(time);
+        showtime.seats_remaining = sqlite3_column_int(stmt, 5);
+        showtime.premium_remaining = sqlite3_column_int(stmt, 6);
+        schedule->showtimes.push_back(showtime);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        log_error("venue schedule query failed", {{"venue_id", venue_id}, {"error", sqlite3_errmsg(conn)}});
+        return nullptr;
+    }
+
+    // Rows come out in time order; regroup each day by movie.
+    std::stable_sort(schedule->showtimes.begin(), schedule->showtimes.end(), [](const ScheduledShowtime& a, const ScheduledShowtime& b) {
+        if (a.day != b.day) return a.day < b.day;
+        return a.movie_id < b.movie_id;
+    });
+    venue_schedules.put(key, schedule);
+    return schedule;
+}
+
+// /auditorium-details bodies. Layouts and prices hardly ever change, and every
+// seat map a client opens asks for one.
+TtlCache<StoredResponse> auditorium_details(std::chrono::seconds(60), 256);
+
+StoredResponse load_auditorium_details(sqlite3* conn, int auditorium_id)
+{
+    std::string key = std::to_string(auditorium_id);
+    StoredResponse cached;
+    if (auditorium_details.get(key, cached)) return cached;
+
+    json audi_json;
+    sqlite3_stmt* stmt;
+    const char* sql = "SELECT Layout, NormalPrice, PremiumPrice FROM Auditoriums WHERE AuditoriumID = ?";
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, 0) != SQLITE_OK) return {500, "Database query failed"};
+    sqlite3_bind_int(stmt, 1, auditorium_id);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        audi_json["layout"] = json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        audi_json["normal_price"] = sqlite3_column_double(stmt, 1);
+        audi_json["premium_price"] = sqlite3_column_double(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+    // Only a clean miss is a 404; an interrupted lookup is not an answer.
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) return {500, "Database query failed"};
+    if (audi_json.is_null()) return {404, "Auditorium not found"};
+    StoredResponse response{200, audi_json.dump()};
+    auditorium_details.put(key, response);
+    return response;
+}
+
+// Session token -> UserID. A token stays valid here for up to a minute after
+// a newer login replaced it in Users.
+TtlCache<int> session_users(std::chrono::seconds(60), 10000);
+
+// "Bearer <token>" (or the bare token) from the Authorization header.
+std::string bearer_token(const crow::request& req)
+{
+    std::string header = req.get_header_value("Authorization");
+    const std::string prefix = "Bearer ";
+    if (header.compare(0, prefix.size(), prefix) == 0) header = header.substr(prefix.size());
+    return header;
+}
+
+// UserID owning the session token; 0 if the token is empty or unknown.
+int authenticated_user(sqlite3* conn, const std::string& token)
+{
+    if (token.empty()) return 0;
+    int user_id = 0;
+    if (session_users.get(token, user_id)) return user_id;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, "SELECT UserID FROM Users WHERE SessionToken = ?", -1, &stmt, 0) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, token.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) user_id = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (user_id) session_users.put(token, user_id);
+    return user_id;
+}
+
+const int MAX_HISTORY_PAGE = 50;
+
+// Handlers never run SQL on a Crow I/O thread. They hand the query to one of
+// these DB threads and return; the response is completed from the DB thread
+// (or from the inventory shard, for seat operations) once the result is in.
+std::unique_ptr<DbExecutor> db_executor;
+const size_t DB_THREADS = 4;
+// Per DbPriority: queue size, the wait above which a standing queue is shed,
+// and the longest any job may wait. Checkout is never shed for load.
+const std::array<DbQueueLimits, DB_PRIORITY_COUNT> DB_QUEUE_LIMITS = {{
+    {256, std::chrono::milliseconds(0), std::chrono::milliseconds(5000)},  // Checkout
+    {128, std::chrono::milliseconds(20), std::chrono::milliseconds(1000)}, // Account
+    {256, std::chrono::milliseconds(5), std::chrono::milliseconds(500)},   // Browse
+}};
+
+const StoredResponse SERVER_BUSY{503, json{{"status", "error"}, {"message", "Server is busy, please try again."}}.dump()};
+
+// How long a read route's query may run before SQLite is told to stop
+// (query_guard.hpp). Writes, and everything on the checkout path, run to
+// completion.
+const auto CATALOG_QUERY_TIMEOUT = std::chrono::milliseconds(500);   // movies, venues, auditorium details
+const auto SHOWTIMES_QUERY_TIMEOUT = std::chrono::milliseconds(1000); // showtime listings, nearby venues
+const auto HISTORY_QUERY_TIMEOUT = std::chrono::milliseconds(2000);   // a user's bookings, analytics
+// How often a pending guarded request checks that its client is still there.
+const auto HANGUP_POLL = std::chrono::milliseconds(50);
+
+const StoredResponse QUERY_ABORTED{503, json{{"status", "error"}, {"message", "The request took too long, please try again."}}.dump()};
+
+// Completes `res` on the I/O thread that owns its connection. Crow's
+// connection state isn't thread-safe, so DB and shard threads never call
+// res.end() themselves.
+void send_response(const crow::request& req, crow::response& res, StoredResponse result, bool replayed = false)
+{
+    asio::post(*req.io_context, [&res, result, replayed, trace = current_trace()] {
+        TraceScope scope(trace);
+        TraceSpan span("response.end", "http");
+        res.code = result.code;
+        res.body = result.body;
+        if (result.code == 503) res.add_header("Retry-After", "1");
+        if (replayed) res.add_header("Idempotent-Replayed", "true");
+        res.end();
+    });
+}
+
+// Runs query(conn) on a DB thread and passes the result to `done` there.
+// A full queue answers 503 straight away instead of queueing without bound,
+// and so does a job the executor sheds (see db_executor.hpp). With a guard,
+// a query that runs too long or whose client has gone is interrupted and
+// answered 503 too, whatever it had built so far.
+void run_on_db(DbPriority priority, std::function<StoredResponse(sqlite3*)> query, std::function<void(const StoredResponse&)> done,
+               std::shared_ptr<QueryGuard> guard = nullptr)
+{
+    bool queued = db_executor->submit(priority, [query, done, guard](sqlite3* conn) {
+        if (guard && guard->cancelled()) {
+            guard->abort_unrun();
+            guard->finish();
+            done(QUERY_ABORTED);
+            return;
+        }
+        StoredResponse result;
+        auto started = std::chrono::steady_clock::now();
+        try {
+            if (guard) {
+                QueryGuard::Scope scope(conn, *guard);
+                result = query(conn);
+            } else {
+                result = query(conn);
+            }
+        } catch (const std::exception& e) {
+            log_error("request failed on DB thread", {{"error", e.what()}});
+            result = {500, "Internal server error"};
+        }
+        if (guard) {
+            guard->finish();
+            guard->count_abort();
+            if (guard->aborted() != QueryGuard::Abort::None) {
+                auto ran = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                log_warning("query interrupted", {{"reason", guard->aborted() == QueryGuard::Abort::Deadline ? "deadline" : "client_gone"},
+                                                  {"ran_ms", ran}});
+                result = QUERY_ABORTED;
+            }
+        }
+        done(result);
+    }, [done, guard] {
+        if (guard) guard->finish();
+        done(SERVER_BUSY);
+    });
+    if (!queued) {
+        if (guard) guard->finish();
+        done(SERVER_BUSY);
+    }
+}
+
+void respond_from_db(const crow::request& req, crow::response& res, DbPriority priority, std::function<StoredResponse(sqlite3*)> query)
+{
+    run_on_db(priority, std::move(query), [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+}
+
+// Checks every HANGUP_POLL, on the connection's I/O thread (the only one that
+// may touch `res`), whether the client is still there while guard's job is
+// pending, and cancels the job once it has hung up.
+void cancel_on_hangup(const crow::request& req, crow::response& res, std::shared_ptr<QueryGuard> guard)
+{
+    auto timer = std::make_shared<asio::steady_timer>(*req.io_context, HANGUP_POLL);
+    timer->async_wait([timer, &req, &res, guard](const asio::error_code& ec) {
+        // Once finished, the response may already have been sent.
+        if (ec || guard->finished()) return;
+        if (!res.is_alive()) {
+            guard->cancel();
+            return;
+        }
+        cancel_on_hangup(req, res, guard);
+    });
+}
+
+// A read whose query may run for at most `timeout`, and is abandoned if the
+// client hangs up first.
+void respond_from_db(const crow::request& req, crow::response& res, DbPriority priority, std::chrono::milliseconds timeout,
+                     std::function<StoredResponse(sqlite3*)> query)
+{
+    auto guard = std::make_shared<QueryGuard>(timeout);
+    cancel_on_hangup(req, res, guard);
+    run_on_db(priority, std::move(query), [&req, &res](const StoredResponse& result) { send_response(req, res, result); }, guard);
+}
+
+// Hands the booking to the owning shard; `done` runs on the shard thread.
+void book_tickets(int showtimeId, int userId, const std::vector<std::string>& seats, const std::string& hold_id,
+                  const std::string& idempotency_key, const std::string& fingerprint,
+                  std::function<void(const StoredResponse&)> done)
+{
+    seat_inventory->post(showtimeId, [=](InventoryShard& shard) {
+        book_seats(shard, showtimeId, userId, seats, hold_id, idempotency_key, fingerprint, [=](StoredResponse response) {
+            // A buyer who reloads the seat map right after booking should see their seats.
+            if (response.code == 200) occupied_seats_flight.invalidate(occupied_seats_key(showtimeId));
+            done(response);
+        });
+    });
+}
+
+void cancel_booking(int showtimeId, sqlite3_int64 order_id, int userId, const std::vector<std::string>& seats,
+                    std::function<void(const StoredResponse&)> done)
+{
+    static Counter& cancelled = metrics().counter("bookings_cancelled_total", "Bookings cancelled by their owner");
+    seat_inventory->post(showtimeId, [=](InventoryShard& shard) {
+        cancel_seats(shard, showtimeId, order_id, userId, seats, [=](StoredResponse response) {
+            if (response.code == 200) {
+                cancelled.inc();
+                occupied_seats_flight.invalidate(occupied_seats_key(showtimeId));
+            }
+            done(response);
+        });
+    });
+}
+
+// Waitlists of sold-out showtimes. One map per inventory shard, indexed by
+// shard index and only touched on that shard's thread, like its seat state.
+// A list stays around with its settled entries (for status lookups) until its
+// showtime leaves the shard. They live in memory only, and with --workers each
+// process keeps its own.
+std::vector<std::unordered_map<int, ShowtimeWaitlist>> waitlists;
+const auto WAITLIST_OFFER_TTL = std::chrono::minutes(2);
+const size_t MAX_WAITLIST = 500;
+
+// Shard thread: offers the showtime's free seats to its waitlist. Runs on
+// every seat release, so a waiting party hears about a seat within one pass
+// of the shard loop.
+void match_waitlist(InventoryShard& shard, int showtimeId)
+{
+    static Counter& offers_made = metrics().counter("waitlist_offers_total", "Seat blocks offered to waitlisted parties");
+    auto& lists = waitlists[shard.index()];
+    auto it = lists.find(showtimeId);
+    if (it == lists.end()) return;
+    ShowtimeSeats* seats = shard.showtime(showtimeId);
+    if (!seats) {
+        lists.erase(it);
+        return;
+    }
+    int offers = it->second.match(*seats, WAITLIST_OFFER_TTL, generate_session_token);
+    if (offers > 0) {
+        offers_made.inc(offers);
+        occupied_seats_flight.invalidate(occupied_seats_key(showtimeId));
+    }
+}
+
+json waitlist_entry_json(int showtimeId, const WaitlistEntry& entry, const ShowtimeWaitlist& list, const ShowtimeSeats& seats)
+{
+    json j;
+    j["status"] = waitlist_status_name(entry.status);
+    j["waitlist_id"] = entry.id;
+    j["showtime_id"] = showtimeId;
+    j["party_size"] = entry.party_size;
+    if (entry.status == WaitlistEntry::Status::Waiting) j["position"] = list.position(entry.id);
+    if (entry.status == WaitlistEntry::Status::Offered) {
+        j["hold_id"] = entry.hold_id;
+        j["seats"] = json::array();
+        for (int index : entry.seats) j["seats"].push_back(seats.seat_identifier(index));
+        auto left = std::chrono::duration_cast<std::chrono::seconds>(entry.offer_expires - std::chrono::steady_clock::now());
+        j["hold_expires_in"] = std::max<long long>(0, left.count());
+    }
+    return j;
+}
+
+// Startup warm-up, see warmup.hpp. /readyz answers 200 once it is done.
+WarmUp warm_up;
+const int WARMUP_DAYS = 2; // showtimes from today to this many days ahead get their seat state loaded
+
+// Starts every warm-up stage at once: the seat snapshot on the shards, the
+// catalog and the auditorium details on DB threads, and the seat state of
+// upcoming showtimes on the shards again (after the snapshot, so only what it
+// didn't cover is read). Returns straight away.
+void start_warm_up(const std::string& seat_snapshot_path)
+{
+    warm_up.begin();
+    auto snapshot = warm_up.stage("seat_snapshot");
+    auto catalog = warm_up.stage("catalog");
+    auto auditoriums = warm_up.stage("auditoriums");
+    auto upcoming = warm_up.stage("upcoming_showtimes");
+    warm_up.seal();
+
+    if (seat_snapshot_path.empty()) snapshot->start(0);
+    else restore_seat_snapshot(seat_snapshot_path, snapshot);
+
+    // A job that doesn't get to run leaves its cache to fill on demand.
+    auto on_db = [](std::function<void(sqlite3*)> job, std::function<void()> skipped) {
+        if (!db_executor->submit(DbPriority::Browse, job, skipped)) skipped();
+    };
+
+    catalog->start(1);
+    on_db([catalog](sqlite3* conn) {
+        load_catalog(conn, true);
+        catalog->done();
+    }, [catalog] { catalog->done(); });
+
+    on_db([auditoriums](sqlite3* conn) {
+        std::vector<int> ids;
         sqlite3_stmt* stmt;
-        const char* sql = "SELECT Layout, NormalPrice, PremiumPrice FROM Auditoriums WHERE AuditoriumID = ?";
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
-            sqlite3_bind_int(stmt, 1, auditoriumId);
+        if (sqlite3_prepare_v2(conn, "SELECT AuditoriumID FROM Auditoriums", -1, &stmt, 0) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) ids.push_back(sqlite3_column_int(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        auditoriums->start(ids.size());
+        for (int id : ids) {
+            load_auditorium_details(conn, id);
+            auditoriums->done();
+        }
+    }, [auditoriums] { auditoriums->start(0); });
+
+    on_db([upcoming](sqlite3* conn) {
+        int today = static_cast<int>(std::time(nullptr) / 86400);
+        std::string from = format_date(today), to = format_date(today + WARMUP_DAYS + 1);
+        std::vector<std::vector<int>> per_shard(seat_inventory->size());
+        size_t total = 0;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(conn, "SELECT ShowtimeID FROM Showtimes WHERE ShowtimeDateTime >= ? AND ShowtimeDateTime < ?", -1, &stmt, 0) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, to.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                int id = sqlite3_column_int(stmt, 0);
+                per_shard[seat_inventory->shard_for(id).index()].push_back(id);
+                ++total;
+            }
+        }
+        sqlite3_finalize(stmt);
+        upcoming->start(total);
+        for (size_t i = 0; i < per_shard.size(); ++i) {
+            seat_inventory->shard(i).post([upcoming, ids = std::move(per_shard[i])](InventoryShard& shard) {
+                for (int id : ids) {
+                    shard.showtime(id);
+                    upcoming->done();
+                }
+            });
+        }
+    }, [upcoming] { upcoming->start(0); });
+}
+
+struct ServerOptions
+{
+    int port = 18080;
+    int workers = 0;
+    int ready_fd = -1;
+    double trace_sample = 0;
+    int slow_query_ms = 50;
+    std::string slow_query_log = "slow_queries.log";
+    std::string log_file;
+    LogLevel log_level = LogLevel::Info;
+    int log_max_mb = 64;
+    std::string seat_snapshot; // default: the database path + ".seats"
+    int seat_snapshot_sec = 60;
+};
+
+// Command line: [--port N] [--db FILE] [--workers N] [--trace-sample RATE]
+//               [--slow-query-ms MS] [--slow-query-log FILE]
+//               [--log-file FILE] [--log-level LEVEL] [--log-max-mb N]
+//               [--seat-snapshot FILE] [--seat-snapshot-sec N]
+// --port defaults to 18080 and --db to blockmyseat.db.
+// --workers N runs a supervisor with N worker processes sharing the port
+// (POSIX only). --ready-fd is passed by the supervisor to its workers.
+// --trace-sample traces that fraction of requests (0 to 1, default 0), see
+// /debug/traces. Statements slower than --slow-query-ms (default 50, -1 turns
+// it off) are appended to --slow-query-log (default slow_queries.log).
+// Log records go to stderr, or to --log-file, rotated every --log-max-mb
+// (default 64) with 5 old files kept; with --workers each worker appends its
+// pid to the file name. --log-level is debug, info (default, one line per
+// request), warning or error.
+// The seat maps are saved to --seat-snapshot (default: the database path +
+// ".seats") every --seat-snapshot-sec seconds (default 60, 0 turns it off)
+// and on a clean shutdown, and restored from it at startup.
+// Returns false, after printing why, on an unknown option or a bad value.
+bool parse_options(int argc, char* argv[], ServerOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--port") options.port = std::stoi(value);
+            else if (arg == "--db") db_path = value;
+            else if (arg == "--workers") options.workers = std::stoi(value);
+            else if (arg == "--ready-fd") options.ready_fd = std::stoi(value);
+            else if (arg == "--trace-sample") options.trace_sample = std::stod(value);
+            else if (arg == "--slow-query-ms") options.slow_query_ms = std::stoi(value);
+            else if (arg == "--slow-query-log") options.slow_query_log = value;
+            else if (arg == "--log-file") options.log_file = value;
+            else if (arg == "--log-level") {
+                if (!parse_log_level(value, options.log_level)) throw std::invalid_argument(value);
+            }
+            else if (arg == "--log-max-mb") options.log_max_mb = std::stoi(value);
+            else if (arg == "--seat-snapshot") options.seat_snapshot = value;
+            else if (arg == "--seat-snapshot-sec") options.seat_snapshot_sec = std::stoi(value);
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends Crow's own log lines through the asynchronous logger.
+class CrowLogHandler : public crow::ILogHandler
+{
+public:
+    void log(std::string message, crow::LogLevel level) override
+    {
+        LogLevel ours = level == crow::LogLevel::Debug ? LogLevel::Debug
+                      : level == crow::LogLevel::Info ? LogLevel::Info
+                      : level == crow::LogLevel::Warning ? LogLevel::Warning
+                      : LogLevel::Error;
+        logger().write(ours, std::move(message), {{"source", "crow"}});
+    }
+};
+
+#ifndef _WIN32
+const auto DRAIN_TIMEOUT = std::chrono::seconds(30);
+const auto DRAIN_QUIET_PERIOD = std::chrono::milliseconds(500);
+
+// Waits for SIGTERM/SIGINT, then stops accepting and gives the requests in
+// flight (and keep-alive clients mid-request) time to finish before stopping
+// the app. Other workers on the same port keep taking new connections.
+template <class App>
+void drain_on_shutdown_signal(App& app)
+{
+    sigset_t signals = shutdown_signals();
+    int sig = 0;
+    sigwait(&signals, &sig);
+    log_info("draining", {{"signal", sig}, {"in_flight", RequestTracker::in_flight().load()}});
+    RequestTracker::draining() = true;
+    app.stop_accepting();
+    seat_inventory->release_watchers(); // don't hold the drain up with parked /seat-updates
+
+    auto deadline = std::chrono::steady_clock::now() + DRAIN_TIMEOUT;
+    auto quiet_since = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto now = std::chrono::steady_clock::now();
+        if (RequestTracker::in_flight().load() > 0) quiet_since = now;
+        else if (now - quiet_since >= DRAIN_QUIET_PERIOD) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    app.stop();
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    ServerOptions options;
+    if (!parse_options(argc, argv, options)) return 2;
+
+#ifndef _WIN32
+    if (options.workers > 0) {
+        std::vector<std::string> worker_args = {argv[0], "--port", std::to_string(options.port), "--db", db_path,
+                                                "--trace-sample", std::to_string(options.trace_sample),
+                                                "--slow-query-ms", std::to_string(options.slow_query_ms),
+                                                "--slow-query-log", options.slow_query_log,
+                                                "--log-level", log_level_name(options.log_level),
+                                                "--log-max-mb", std::to_string(options.log_max_mb),
+                                                "--seat-snapshot-sec", std::to_string(options.seat_snapshot_sec)};
+        if (!options.seat_snapshot.empty()) {
+            worker_args.push_back("--seat-snapshot");
+            worker_args.push_back(options.seat_snapshot);
+        }
+        if (!options.log_file.empty()) {
+            worker_args.push_back("--log-file");
+            worker_args.push_back(options.log_file);
+        }
+        return Supervisor(executable_path(argv[0]), worker_args, options.workers).run();
+    }
+    block_shutdown_signals(); // before any thread exists, see drain_on_shutdown_signal()
+#endif
+    // A worker shares the database with its siblings, so its seat state can go stale.
+    bool supervised = options.ready_fd >= 0;
+
+    std::string log_file = options.log_file;
+#ifndef _WIN32
+    if (supervised && !log_file.empty()) log_file += "." + std::to_string(getpid()); // one writer per file
+#endif
+    logger().set_level(options.log_level);
+    logger().start(log_file, static_cast<size_t>(options.log_max_mb) * 1024 * 1024, 5);
+    static CrowLogHandler crow_log_handler;
+    crow::logger::setHandler(&crow_log_handler);
+    // Our access records replace Crow's per-request lines unless debugging.
+    crow::logger::setLogLevel(options.log_level == LogLevel::Debug ? crow::LogLevel::Debug : crow::LogLevel::Warning);
+    Tracer::instance().set_sample_rate(options.trace_sample);
+    slow_query_log().start(options.slow_query_log, db_path, std::chrono::milliseconds(options.slow_query_ms));
+    init_database();
+
+    // One inventory shard per core; each owns the seat state of its showtimes.
+    size_t shard_count = std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+    auto refresh_after = supervised ? std::chrono::milliseconds(1000) : std::chrono::milliseconds(0);
+    seat_inventory = std::make_unique<SeatInventory>(shard_count, db_path, load_showtime_seats, refresh_after);
+    waitlists.resize(shard_count);
+    seat_inventory->set_release_listener([](InventoryShard& shard, int showtimeId, const std::vector<int>&) {
+        match_waitlist(shard, showtimeId);
+    });
+    db_executor = std::make_unique<DbExecutor>(DB_THREADS, DB_QUEUE_LIMITS, db_path);
+
+    // Warm restart from the last seat snapshot, then keep writing new ones.
+    // Workers share one file; any of their snapshots is as good as another.
+    SeatSnapshotter seat_snapshotter;
+    std::string snapshot_path;
+    if (options.seat_snapshot_sec > 0) {
+        snapshot_path = options.seat_snapshot.empty() ? db_path + ".seats" : options.seat_snapshot;
+        seat_snapshotter.start(snapshot_path, std::chrono::seconds(options.seat_snapshot_sec), [] { return seat_inventory->snapshot(); });
+    }
+    start_warm_up(snapshot_path);
+    HotShowtimeKeeper hot_showtimes;
+    hot_showtimes.start(trending, HOT_SHOWTIMES, HOT_SHOWTIME_REFRESH, [](const std::vector<int>& ids) {
+        for (int id : ids) seat_inventory->post(id, [id](InventoryShard& shard) { shard.showtime(id); });
+    });
+
+    // Declare the app with the middleware directly in the template.
+    crow::App<RequestTracker, RequestTracing, AccessLog, crow::CORSHandler> app;
+
+    // Get a reference to the CORS middleware and configure it.
+    auto& cors = app.get_middleware<crow::CORSHandler>();
+    // A simple policy: allow all origins, all methods, all headers.
+    cors
+    .global()
+    .headers("Content-Type", "Idempotency-Key", "Authorization") // Allow the content type, retry key and session token
+    .methods("POST"_method, "GET"_method, "OPTIONS"_method) // Allow these HTTP methods
+    .origin("*"); // Allow any origin (including file://)
+
+    // --- Define your routes ---
+    CROW_ROUTE(app, "/signup").methods("POST"_method)
+    ([](const crow::request& req, crow::response& res)
+    {
+        auto j = json::parse(req.body);
+        std::string username = j["username"];
+        std::string email = j["email"];
+        std::string password = j["password"];
+
+        respond_from_db(req, res, DbPriority::Account, [=](sqlite3* db) -> StoredResponse {
+            sqlite3_stmt* stmt;
+            const char* sql_check = "SELECT UserID FROM Users WHERE Username = ? OR Email = ?";
+            sqlite3_prepare_v2(db, sql_check, -1, &stmt, 0);
+            sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_STATIC);
+
+            if (sqlite3_step(stmt) == SQLITE_ROW) 
+            {
+                sqlite3_finalize(stmt);
+                return {409, json{{"status", "error"}, {"message", "Username or email already taken."}}.dump()};
+            }
+            sqlite3_finalize(stmt);
+
+            const char* sql_insert = "INSERT INTO Users (Username, Email, Password) VALUES (?, ?, ?)";
+            sqlite3_prepare_v2(db, sql_insert, -1, &stmt, 0);
+            sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, password.c_str(), -1, SQLITE_STATIC);
+
+            if (sqlite3_step(stmt) != SQLITE_DONE) 
+            {
+                sqlite3_finalize(stmt);
+                return {500, json{{"status", "error"}, {"message", "Failed to create user."}}.dump()};
+            }
+            sqlite3_finalize(stmt);
+
+            return {201, json{{"status", "success"}, {"message", "Account created successfully."}}.dump()};
+        });
+    });
+
+     CROW_ROUTE(app, "/login").methods("POST"_method)
+    ([](const crow::request& req, crow::response& res){
+        auto j = json::parse(req.body);
+        std::string username = j["username"];
+        std::string password = j["password"];
+
+        respond_from_db(req, res, DbPriority::Account, [=](sqlite3* db) -> StoredResponse {
+            sqlite3_stmt* stmt;
+            const char* sql_select = "SELECT UserID, Password FROM Users WHERE Username = ?";
+        
+            if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) != SQLITE_OK) {
+                return {500, "DB error"};
+            }
+            sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+
             if (sqlite3_step(stmt) == SQLITE_ROW) {
-                audi_json["layout"] = json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-                audi_json["normal_price"] = sqlite3_column_double(stmt, 1);
-                audi_json["premium_price"] = sqlite3_column_double(stmt, 2);
+                int userId = sqlite3_column_int(stmt, 0);
+                std::string password_from_db = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            
+                if (password == password_from_db) {
+                    sqlite3_finalize(stmt);
+                    std::string token = generate_session_token();
+                
+                    // Store token in DB
+                    const char* sql_update = "UPDATE Users SET SessionToken = ? WHERE UserID = ?";
+                    sqlite3_prepare_v2(db, sql_update, -1, &stmt, 0);
+                    sqlite3_bind_text(stmt, 1, token.c_str(), -1, SQLITE_STATIC);
+                    sqlite3_bind_int(stmt, 2, userId);
+                    sqlite3_step(stmt);
+                    sqlite3_finalize(stmt);
+                    session_users.put(token, userId);
+
+                    json res_json;
+                    res_json["status"] = "success";
+                    res_json["message"] = "Login successful!";
+                    res_json["token"] = token;
+                    res_json["userId"] = userId;
+                    return {200, res_json.dump()};
+                }
+            }
+        
+            sqlite3_finalize(stmt);
+            return {401, json{{"status", "error"}, {"message", "Invalid username or password."}}.dump()};
+        });
+    });
+    CROW_ROUTE(app, "/movies").methods("GET"_method)
+    ([](const crow::request& req, crow::response& res)
+    {
+        respond_from_db(req, res, DbPriority::Browse, CATALOG_QUERY_TIMEOUT, [](sqlite3* db) -> StoredResponse {
+            json movies_json = json::array();
+            sqlite3_stmt* stmt;
+            const char* sql_select = "SELECT MovieID, Title, PosterURL, Synopsis, DurationMinutes, Rating FROM Movies";
+
+            if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) 
+            {
+                while (sqlite3_step(stmt) == SQLITE_ROW) 
+                {
+                    json movie;
+                    movie["id"] = sqlite3_column_int(stmt, 0);
+                    movie["title"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                    movie["poster_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+                    movie["synopsis"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+                    movie["duration_minutes"] = sqlite3_column_int(stmt, 4);
+                    movie["rating"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+                    movies_json.push_back(movie);
+                }
+            }
+            sqlite3_finalize(stmt);
+
+            return {200, movies_json.dump()};
+        });
+    });
+
+    CROW_ROUTE(app, "/venues").methods("GET"_method)
+    ([](const crow::request& req, crow::response& res){
+        respond_from_db(req, res, DbPriority::Browse, CATALOG_QUERY_TIMEOUT, [](sqlite3* db) -> StoredResponse {
+            json venues_json = json::array();
+            sqlite3_stmt* stmt;
+            const char* sql_select = "SELECT VenueID, Name, Location, ImageURL, AuditoriumCount, Latitude, Longitude FROM Venues";
+
+            if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) 
+            {
+                while (sqlite3_step(stmt) == SQLITE_ROW) 
+                {
+                    json venue;
+                    venue["id"] = sqlite3_column_int(stmt, 0);
+                    venue["name"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                    venue["location"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+                    venue["image_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+                    venue["auditorium_count"] = sqlite3_column_int(stmt, 4);
+                    venue["latitude"] = sqlite3_column_type(stmt, 5) == SQLITE_NULL ? json(nullptr) : json(sqlite3_column_double(stmt, 5));
+                    venue["longitude"] = sqlite3_column_type(stmt, 6) == SQLITE_NULL ? json(nullptr) : json(sqlite3_column_double(stmt, 6));
+                    venues_json.push_back(venue);
+                }
+            }
+            sqlite3_finalize(stmt);
+
+            return {200, venues_json.dump()};
+        });
+    });
+    // Venues near a point, nearest first:
+    //   /venues/nearby?lat=12.97&lon=77.59&radius=10&limit=20&showtimes=3
+    // radius is in km. With showtimes=N each venue lists its next N showtimes
+    // from now (UTC), or from the start of `date` if given.
+    CROW_ROUTE(app, "/venues/nearby")
+    ([](const crow::request& req, crow::response& res){
+        double lat = 0, lon = 0, radius_km = 10;
+        int limit = 20, showtime_count = 0;
+        int from_day = static_cast<int>(std::time(nullptr) / 86400);
+        std::string from_time;
+        if (!req.url_params.get("lat") || !req.url_params.get("lon") || !number_param(req, "lat", lat) || !number_param(req, "lon", lon) ||
+            !number_param(req, "radius", radius_km) || !int_param(req, "limit", limit) || !int_param(req, "showtimes", showtime_count)) {
+            send_response(req, res, {400, "Missing or invalid lat, lon, radius, limit or showtimes parameter"});
+            return;
+        }
+        if (!(lat >= -90 && lat <= 90) || !(lon >= -180 && lon <= 180) || !(radius_km > 0 && radius_km <= MAX_NEARBY_RADIUS_KM) ||
+            limit < 1 || limit > 100 || showtime_count < 0 || showtime_count > 10) {
+            send_response(req, res, {400, "lat, lon, radius, limit or showtimes out of range"});
+            return;
+        }
+        if (const char* date_str = req.url_params.get("date")) {
+            if (!parse_date(date_str, from_day)) {
+                send_response(req, res, {400, "Invalid date parameter"});
+                return;
+            }
+        } else {
+            std::time_t now = std::time(nullptr);
+            char buf[8];
+            std::strftime(buf, sizeof(buf), "%H:%M", std::gmtime(&now));
+            from_time = buf;
+        }
+
+        respond_from_db(req, res, DbPriority::Browse, SHOWTIMES_QUERY_TIMEOUT, [=](sqlite3* db) -> StoredResponse {
+            auto catalog = load_catalog(db);
+            if (!catalog) return {500, "Database query failed"};
+
+            json venues = json::array();
+            for (const GeoMatch& match : catalog->venue_grid.within(lat, lon, radius_km, limit)) {
+                const VenueSummary* venue = catalog->venue(match.id);
+                json item = {{"venue_id", venue->venue_id}, {"venue_name", venue->name}, {"venue_rating", venue->rating},
+                             {"venue_image_url", venue->image_url}, {"location", venue->location},
+                             {"latitude", venue->latitude}, {"longitude", venue->longitude},
+                             {"distance_km", std::round(match.distance_km * 100) / 100}};
+                if (showtime_count > 0) {
+                    auto schedule = load_venue_schedule(db, venue->venue_id);
+                    if (!schedule) return {500, "Database query failed"};
+                    json next = json::array();
+                    for (const auto& showtime : schedule->upcoming(from_day, from_time, showtime_count)) {
+                        const MovieSummary* movie = catalog->movie(showtime.movie_id);
+                        next.push_back({{"date", format_date(showtime.day)}, {"time", showtime.time},
+                                        {"showtime_id", showtime.showtime_id}, {"auditorium_id", showtime.auditorium_id},
+                                        {"movie_id", showtime.movie_id}, {"title", movie ? json(movie->title) : json(nullptr)},
+                                        {"sold_out", showtime.seats_remaining <= 0}});
+                    }
+                    item["next_showtimes"] = next;
+                }
+                venues.push_back(item);
+            }
+            return {200, venues.dump()};
+        });
+    });
+
+    // What's playing at one venue, a day (or a few) at a time:
+    //   /venues/2/showtimes?date=2025-08-22&days=1
+    // date defaults to today (UTC). "next_date" is the first later day with
+    // showtimes, to pass as date for the next page; null when there is none.
+    CROW_ROUTE(app, "/venues/<int>/showtimes")
+    ([](const crow::request& req, crow::response& res, int venue_id){
+        const char* date_str = req.url_params.get("date");
+
+        int first_day = static_cast<int>(std::time(nullptr) / 86400);
+        int count = 1;
+        if (!int_param(req, "days", count)) count = 0;
+        if ((date_str && !parse_date(date_str, first_day)) || count < 1 || count > MAX_SCHEDULE_DAYS) {
+            send_response(req, res, {400, "Invalid date or days parameter"});
+            return;
+        }
+
+        auto query = [=](sqlite3* db) {
+            auto catalog = load_catalog(db);
+            if (catalog && !catalog->venue(venue_id)) catalog = load_catalog(db, true);
+            if (!catalog) return StoredResponse{500, "Database query failed"};
+            const VenueSummary* venue = catalog->venue(venue_id);
+            if (!venue) return StoredResponse{404, "Venue not found"};
+
+            auto schedule = load_venue_schedule(db, venue_id);
+            if (!schedule) return StoredResponse{500, "Database query failed"};
+
+            json days = json::array();
+            auto it = schedule->first_on_or_after(first_day);
+            for (int day = first_day; day < first_day + count; ++day) {
+                json movies = json::array();
+                for (; it != schedule->showtimes.end() && it->day == day; ++it) {
+                    if (movies.empty() || movies.back()["movie_id"] != it->movie_id) {
+                        const MovieSummary* movie = catalog->movie(it->movie_id);
+                        if (!movie) {
+                            catalog = load_catalog(db, true);
+                            if (!catalog) return StoredResponse{500, "Database query failed"};
+                            venue = catalog->venue(venue_id);
+                            movie = catalog->movie(it->movie_id);
+                        }
+                        movies.push_back({{"movie_id", it->movie_id},
+                                          {"title", movie ? json(movie->title) : json(nullptr)},
+                                          {"poster_url", movie ? json(movie->poster_url) : json(nullptr)},
+                                          {"showtimes", json::array()}});
+                    }
+                    movies.back()["showtimes"].push_back({
+                        {"time", it->time},
+                        {"showtime_id", it->showtime_id},
+                        {"auditorium_id", it->auditorium_id},
+                        {"seats_remaining", it->seats_remaining},
+                        {"premium_remaining", it->premium_remaining},
+                        {"sold_out", it->seats_remaining <= 0},
+                    });
+                }
+                days.push_back({{"date", format_date(day)}, {"movies", movies}});
+            }
+            auto next = schedule->first_on_or_after(first_day + count);
+
+            json response;
+            response["venue"] = {{"venue_id", venue->venue_id}, {"venue_name", venue->name}, {"venue_rating", venue->rating},
+                                 {"venue_image_url", venue->image_url}, {"location", venue->location}};
+            response["days"] = days;
+            response["next_date"] = next == schedule->showtimes.end() ? json(nullptr) : json(format_date(next->day));
+            return StoredResponse{200, response.dump()};
+        };
+        showtimes_flight.run("venue-showtimes:" + std::to_string(venue_id) + ":" + std::to_string(first_day) + ":" + std::to_string(count),
+                             [query](SingleFlight<StoredResponse>::Callback done) {
+                                 run_on_db(DbPriority::Browse, query, done, std::make_shared<QueryGuard>(SHOWTIMES_QUERY_TIMEOUT));
+                             },
+                             [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+    });
+
+    CROW_ROUTE(app, "/movies/<int>")
+([](const crow::request& req, crow::response& res, int movieID){
+    respond_from_db(req, res, DbPriority::Browse, CATALOG_QUERY_TIMEOUT, [movieID](sqlite3* db) -> StoredResponse {
+        json movie_json;
+        sqlite3_stmt* stmt;
+        const char* sql_select = "SELECT MovieID, Title, PosterURL, Synopsis, DurationMinutes, Rating FROM Movies WHERE MovieID = ?";
+
+        if (sqlite3_prepare_v2(db, sql_select, -1, &stmt, 0) == SQLITE_OK) {
+            sqlite3_bind_int(stmt, 1, movieID);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                movie_json["id"] = sqlite3_column_int(stmt, 0);
+                movie_json["title"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                movie_json["poster_url"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+                movie_json["synopsis"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+                movie_json["duration_minutes"] = sqlite3_column_int(stmt, 4);
+                movie_json["rating"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (movie_json.is_null()) {
+            return {404, "Movie not found"};
+        }
+        return {200, movie_json.dump()};
+    });
+});
+
+// === NEW ENDPOINT 2: Get showtimes for a movie on a specific date ===
+CROW_ROUTE(app, "/showtimes")
+([](const crow::request& req, crow::response& res){
+    auto movie_id_str = req.url_params.get("movie_id");
+    auto date_str = req.url_params.get("date");
+
+    int movie_id = 0;
+    if (!movie_id_str || !date_str || !int_param(req, "movie_id", movie_id)) {
+        send_response(req, res, {400, "Missing movie_id or date parameter"});
+        return;
+    }
+
+    // Identical queries arriving together share one execution and its body.
+    std::string date = date_str;
+    auto query = [=](sqlite3* db) {
+        // This SQL query is now correct because V.Rating exists.
+        std::string sql = "SELECT V.VenueID, V.Name, V.Rating, V.ImageURL, strftime('%H:%M', S.ShowtimeDateTime), S.ShowtimeID, S.AuditoriumID, "
+                          "S.SeatsRemaining, S.PremiumRemaining "
+                          "FROM Showtimes AS S JOIN Venues AS V ON S.VenueID = V.VenueID "
+                          "WHERE S.MovieID = ? AND S.ShowtimeDateTime >= ? AND S.ShowtimeDateTime < date(?, '+1 day') "
+                          "ORDER BY V.VenueID, S.ShowtimeDateTime";
+    
+        sqlite3_stmt* stmt;
+        json venues_with_showtimes = json::object();
+        int rc;
+
+        {
+            TraceSpan span("showtimes.prepare");
+            if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
+                log_error("showtimes prepare failed", {{"route", "/showtimes"}, {"movie_id", movie_id}, {"error", sqlite3_errmsg(db)}});
+                return StoredResponse{500, "Database query preparation failed"};
+            }
+        }
+
+        sqlite3_bind_int(stmt, 1, movie_id);
+        sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, date.c_str(), -1, SQLITE_STATIC);
+
+        // Rows are read out first and turned into JSON afterwards, so a trace
+        // tells SQLite's time and the JSON building apart.
+        struct Row
+        {
+            int venue_id;
+            std::string venue_name;
+            double venue_rating;
+            std::string venue_image_url;
+            std::string time;
+            int showtime_id, auditorium_id, seats_remaining, premium_remaining;
+        };
+        std::vector<Row> rows;
+        {
+            TraceSpan span("showtimes.step");
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                rows.push_back({sqlite3_column_int(stmt, 0),
+                                reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                                sqlite3_column_double(stmt, 2),
+                                reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)),
+                                reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)),
+                                sqlite3_column_int(stmt, 5), sqlite3_column_int(stmt, 6),
+                                sqlite3_column_int(stmt, 7), sqlite3_column_int(stmt, 8)});
+            }
+
+            if (rc != SQLITE_DONE) {
+                log_error("showtimes query failed", {{"route", "/showtimes"}, {"movie_id", movie_id}, {"error", sqlite3_errmsg(db)}});
+            }
+
+            sqlite3_finalize(stmt);
+        }
+
+        json final_response = json::array();
+        {
+            TraceSpan span("showtimes.build_json");
+            for (const auto& row : rows) {
+                std::string venue_id_key = std::to_string(row.venue_id);
+
+                if (venues_with_showtimes.find(venue_id_key) == venues_with_showtimes.end()) {
+                    venues_with_showtimes[venue_id_key]["venue_id"] = row.venue_id;
+                    venues_with_showtimes[venue_id_key]["venue_name"] = row.venue_name;
+                    venues_with_showtimes[venue_id_key]["venue_rating"] = row.venue_rating;
+                    venues_with_showtimes[venue_id_key]["venue_image_url"] = row.venue_image_url;
+                    venues_with_showtimes[venue_id_key]["showtimes"] = json::array();
+                }
+
+                json showtime_obj;
+                showtime_obj["time"] = row.time;
+                showtime_obj["showtime_id"] = row.showtime_id;
+                showtime_obj["auditorium_id"] = row.auditorium_id;
+                showtime_obj["seats_remaining"] = row.seats_remaining;
+                showtime_obj["premium_remaining"] = row.premium_remaining;
+                showtime_obj["sold_out"] = row.seats_remaining <= 0;
+
+                venues_with_showtimes[venue_id_key]["showtimes"].push_back(showtime_obj);
+            }
+
+            for (auto& el : venues_with_showtimes.items()) {
+                final_response.push_back(el.value());
+            }
+        }
+
+        TraceSpan span("showtimes.dump_json");
+        return StoredResponse{200, final_response.dump()};
+    };
+    showtimes_flight.run("showtimes:" + std::to_string(movie_id) + ":" + date,
+                         [query](SingleFlight<StoredResponse>::Callback done) {
+                             run_on_db(DbPriority::Browse, query, done, std::make_shared<QueryGuard>(SHOWTIMES_QUERY_TIMEOUT));
+                         },
+                         [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+});
+// Showtimes for several days (and optionally several movies) in one response:
+//   /showtimes/batch?movie_ids=1,2&start=2025-08-22&days=7
+//   /showtimes/batch?movie_ids=1&dates=2025-08-22,2025-08-24
+// Every requested date is present in "movies", empty if nothing is showing.
+// Venue details are listed once under "venues" rather than per showtime.
+CROW_ROUTE(app, "/showtimes/batch")
+([](const crow::request& req, crow::response& res){
+    const char* movie_ids_str = req.url_params.get("movie_ids");
+    if (!movie_ids_str) movie_ids_str = req.url_params.get("movie_id");
+    const char* start_str = req.url_params.get("start");
+    const char* dates_str = req.url_params.get("dates");
+
+    std::vector<int> movie_ids;
+    if (!movie_ids_str || !parse_id_list(movie_ids_str, movie_ids) || static_cast<int>(movie_ids.size()) > MAX_BATCH_MOVIES) {
+        send_response(req, res, {400, "Missing or invalid movie_ids parameter"});
+        return;
+    }
+
+    std::vector<int> days;
+    if (dates_str) {
+        std::stringstream ss(dates_str);
+        std::string item;
+        int day;
+        while (std::getline(ss, item, ',')) {
+            if (!parse_date(item, day)) {
+                send_response(req, res, {400, "Invalid date: " + item});
+                return;
+            }
+            days.push_back(day);
+        }
+    } else if (start_str) {
+        int first_day;
+        int count = 7;
+        if (!int_param(req, "days", count)) count = 0;
+        if (!parse_date(start_str, first_day) || count < 1 || count > MAX_BATCH_DAYS) {
+            send_response(req, res, {400, "Invalid start or days parameter"});
+            return;
+        }
+        for (int i = 0; i < count; ++i) days.push_back(first_day + i);
+    }
+    std::sort(days.begin(), days.end());
+    days.erase(std::unique(days.begin(), days.end()), days.end());
+    std::sort(movie_ids.begin(), movie_ids.end());
+    movie_ids.erase(std::unique(movie_ids.begin(), movie_ids.end()), movie_ids.end());
+    if (days.empty() || static_cast<int>(days.size()) > MAX_BATCH_DAYS) {
+        send_response(req, res, {400, "Give start (and days) or up to 31 dates"});
+        return;
+    }
+
+    auto query = [=](sqlite3* db) {
+        json venues = json::object();
+        json movies = json::object();
+        for (int movie_id : movie_ids) {
+            json by_date = json::object();
+            std::shared_ptr<const MovieWeek> week;
+            for (int day : days) {
+                if (!week || week_start(day) != week->first_day) {
+                    week = load_movie_week(db, movie_id, week_start(day));
+                    if (!week) return StoredResponse{500, "Database query failed"};
+                    for (const auto& venue : week->venues) {
+                        std::string venue_key = std::to_string(venue.venue_id);
+                        if (venues.contains(venue_key)) continue;
+                        venues[venue_key] = {{"venue_id", venue.venue_id}, {"venue_name", venue.name},
+                                             {"venue_rating", venue.rating}, {"venue_image_url", venue.image_url}};
+                    }
+                }
+
+                json day_venues = json::array();
+                auto first = std::lower_bound(week->showtimes.begin(), week->showtimes.end(), day,
+                                              [](const ScheduledShowtime& s, int d) { return s.day < d; });
+                for (auto it = first; it != week->showtimes.end() && it->day == day; ++it) {
+                    if (day_venues.empty() || day_venues.back()["venue_id"] != it->venue_id) {
+                        day_venues.push_back({{"venue_id", it->venue_id}, {"showtimes", json::array()}});
+                    }
+                    day_venues.back()["showtimes"].push_back({
+                        {"time", it->time},
+                        {"showtime_id", it->showtime_id},
+                        {"auditorium_id", it->auditorium_id},
+                        {"seats_remaining", it->seats_remaining},
+                        {"premium_remaining", it->premium_remaining},
+                        {"sold_out", it->seats_remaining <= 0},
+                    });
+                }
+                by_date[format_date(day)] = day_venues;
+            }
+            movies[std::to_string(movie_id)] = by_date;
+        }
+        return StoredResponse{200, json{{"venues", venues}, {"movies", movies}}.dump()};
+    };
+
+    std::string key = "showtimes-batch:";
+    for (int movie_id : movie_ids) key += std::to_string(movie_id) + ",";
+    key += ":";
+    for (int day : days) key += std::to_string(day) + ",";
+    showtimes_flight.run(key,
+                         [query](SingleFlight<StoredResponse>::Callback done) {
+                             run_on_db(DbPriority::Browse, query, done, std::make_shared<QueryGuard>(SHOWTIMES_QUERY_TIMEOUT));
+                         },
+                         [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+});
+
+// Movies and showtimes selling the most tickets lately, most first:
+//   /trending?window=hour&limit=10   (window: hour or day)
+// Ticket counts are estimates that can run slightly high, never low.
+CROW_ROUTE(app, "/trending")
+([](const crow::request& req, crow::response& res){
+    std::string window_name = req.url_params.get("window") ? req.url_params.get("window") : "hour";
+    int limit = 10;
+    if (!int_param(req, "limit", limit)) limit = 0;
+    if ((window_name != "hour" && window_name != "day") || limit < 1 || limit > static_cast<int>(MAX_TRENDING)) {
+        send_response(req, res, {400, "Invalid window or limit parameter"});
+        return;
+    }
+    TrendingWindow window = window_name == "hour" ? TrendingWindow::Hour : TrendingWindow::Day;
+
+    respond_from_db(req, res, DbPriority::Browse, CATALOG_QUERY_TIMEOUT, [=](sqlite3* db) -> StoredResponse {
+        auto catalog = load_catalog(db);
+        auto title = [&](int movie_id) -> json {
+            const MovieSummary* movie = catalog ? catalog->movie(movie_id) : nullptr;
+            return movie ? json(movie->title) : json(nullptr);
+        };
+        json movies = json::array();
+        for (const auto& entry : trending.top_movies(window, limit)) {
+            const MovieSummary* movie = catalog ? catalog->movie(entry.key) : nullptr;
+            movies.push_back({{"movie_id", entry.key}, {"title", title(entry.key)},
+                              {"poster_url", movie ? json(movie->poster_url) : json(nullptr)}, {"tickets", entry.count}});
+        }
+        json showtimes = json::array();
+        for (const auto& entry : trending.top_showtimes(window, limit)) {
+            showtimes.push_back({{"showtime_id", entry.key}, {"movie_id", entry.tag}, {"title", title(entry.tag)}, {"tickets", entry.count}});
+        }
+        return {200, json{{"window", window_name}, {"movies", movies}, {"showtimes", showtimes}}.dump()};
+    });
+});
+
+// Occupancy and revenue from OccupancyRollup, so the cost depends on the days
+// and movies asked for, not on how many bookings there are:
+//   /analytics?from=2025-08-22&to=2025-08-28&by=movie,venue&movie_id=1&venue_id=2
+// `by` is any of day, movie, venue (default: all three); from/to default to
+// the coming week, at most MAX_ANALYTICS_DAYS apart; movie_id and venue_id
+// filter. Revenue is in the auditoriums' currency, seats at their current
+// prices.
+const int MAX_ANALYTICS_DAYS = 92;
+CROW_ROUTE(app, "/analytics")
+([](const crow::request& req, crow::response& res){
+    int today = static_cast<int>(std::time(nullptr) / 86400);
+    int from_day = today, to_day = today + 6;
+    bool by_day = true, by_movie = true, by_venue = true;
+    int movie_id = 0, venue_id = 0;
+    bool valid = true;
+    try {
+        if (req.url_params.get("from")) valid = valid && parse_date(req.url_params.get("from"), from_day);
+        if (req.url_params.get("to")) valid = valid && parse_date(req.url_params.get("to"), to_day);
+        valid = valid && int_param(req, "movie_id", movie_id) && int_param(req, "venue_id", venue_id);
+        if (req.url_params.get("by")) {
+            by_day = by_movie = by_venue = false;
+            std::stringstream ss(req.url_params.get("by"));
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                if (item == "day") by_day = true;
+                else if (item == "movie") by_movie = true;
+                else if (item == "venue") by_venue = true;
+                else valid = false;
             }
         }
+    } catch (const std::exception&) {
+        valid = false;
+    }
+    if (!valid || to_day < from_day || to_day - from_day >= MAX_ANALYTICS_DAYS || movie_id < 0 || venue_id < 0) {
+        send_response(req, res, {400, "Invalid from, to, by, movie_id or venue_id parameter"});
+        return;
+    }
+
+    respond_from_db(req, res, DbPriority::Browse, HISTORY_QUERY_TIMEOUT, [=](sqlite3* db) -> StoredResponse {
+        std::string group;
+        if (by_day) group += "Day, ";
+        if (by_movie) group += "MovieID, ";
+        if (by_venue) group += "VenueID, ";
+        // Day leads the primary key, so the date range is one range scan.
+        std::string sql = "SELECT " + group + "SUM(Showtimes), SUM(Capacity), SUM(PremiumCapacity), SUM(SeatsSold), "
+                          "SUM(PremiumSold), SUM(RevenueCents) FROM OccupancyRollup WHERE Day >= ? AND Day <= ?";
+        if (movie_id) sql += " AND MovieID = ?";
+        if (venue_id) sql += " AND VenueID = ?";
+        if (!group.empty()) {
+            group.resize(group.size() - 2);
+            sql += " GROUP BY " + group + " ORDER BY " + group;
+        }
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) return {500, "DB error"};
+        std::string from = format_date(from_day), to = format_date(to_day);
+        int param = 1;
+        sqlite3_bind_text(stmt, param++, from.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, param++, to.c_str(), -1, SQLITE_STATIC);
+        if (movie_id) sqlite3_bind_int(stmt, param++, movie_id);
+        if (venue_id) sqlite3_bind_int(stmt, param++, venue_id);
+
+        auto catalog = load_catalog(db);
+        json rows = json::array();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            json row;
+            int col = 0;
+            if (by_day) row["day"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col++));
+            if (by_movie) {
+                int id = sqlite3_column_int(stmt, col++);
+                const MovieSummary* movie = catalog ? catalog->movie(id) : nullptr;
+                row["movie_id"] = id;
+                row["title"] = movie ? json(movie->title) : json(nullptr);
+            }
+            if (by_venue) {
+                int id = sqlite3_column_int(stmt, col++);
+                const VenueSummary* venue = catalog ? catalog->venue(id) : nullptr;
+                row["venue_id"] = id;
+                row["venue"] = venue ? json(venue->name) : json(nullptr);
+            }
+            int64_t capacity = sqlite3_column_int64(stmt, col + 1);
+            int64_t sold = sqlite3_column_int64(stmt, col + 3);
+            row["showtimes"] = sqlite3_column_int64(stmt, col);
+            row["capacity"] = capacity;
+            row["premium_capacity"] = sqlite3_column_int64(stmt, col + 2);
+            row["seats_sold"] = sold;
+            row["premium_sold"] = sqlite3_column_int64(stmt, col + 4);
+            row["occupancy"] = capacity > 0 ? static_cast<double>(sold) / capacity : 0.0;
+            row["revenue"] = sqlite3_column_int64(stmt, col + 5) / 100.0;
+            // With nothing to group by, SUM over no rows is one row of NULLs.
+            if (row["showtimes"] == 0 && group.empty()) continue;
+            rows.push_back(row);
+        }
         sqlite3_finalize(stmt);
-        if (audi_json.is_null()) return crow::response(404, "Auditorium not found");
-        return crow::response(200, audi_json.dump());
+        if (rc != SQLITE_DONE) return {500, "DB error"};
+
+        json by = json::array();
+        if (by_day) by.push_back("day");
+        if (by_movie) by.push_back("movie");
+        if (by_venue) by.push_back("venue");
+        return {200, json{{"from", from}, {"to", to}, {"by", by}, {"rows", rows}}.dump()};
+    });
+});
+
+CROW_ROUTE(app, "/auditorium-details/<int>")
+    ([](const crow::request& req, crow::response& res, int auditoriumId){
+        StoredResponse cached;
+        if (auditorium_details.get(std::to_string(auditoriumId), cached)) {
+            send_response(req, res, cached);
+            return;
+        }
+        respond_from_db(req, res, DbPriority::Browse, CATALOG_QUERY_TIMEOUT, [auditoriumId](sqlite3* db) { return load_auditorium_details(db, auditoriumId); });
     });
     CROW_ROUTE(app, "/book-tickets").methods("POST"_method)
-    ([](const crow::request& req){
-        auto j = json::parse(req.body);
+    ([](const crow::request& req, crow::response& res){
+        json j;
+        {
+            TraceSpan span("book.parse_body");
+            j = json::parse(req.body);
+        }
         int showtimeId = j["showtime_id"];
         int userId = j["user_id"];
-        json seats = j["seats"]; // This is an array of strings
+        std::vector<std::string> seats = j["seats"].get<std::vector<std::string>>();
+        std::string hold_id = j.value("hold_id", ""); // set when the seats came from /best-available
+
+        // Without a key every request is a new booking attempt.
+        std::string idempotency_key = req.get_header_value("Idempotency-Key");
+        if (idempotency_key.empty()) {
+            book_tickets(showtimeId, userId, seats, hold_id, "", "",
+                         [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+            return;
+        }
 
-        const char* sql = "INSERT INTO Bookings (ShowtimeID, UserID, SeatIdentifier) VALUES (?, ?, ?)";
+        std::string fingerprint = std::to_string(showtimeId) + ":" + std::to_string(userId) + ":" + j["seats"].dump();
+        std::string cache_key = idempotency_cache_key(userId, idempotency_key);
+        StoredResponse stored;
+        // A retry that arrives while the original is still running gets its response.
+        auto replay = [&req, &res](const StoredResponse& result) { send_response(req, res, result, true); };
+        switch (idempotency_cache.claim(cache_key, fingerprint, stored, replay)) {
+            case IdempotencyCache::Claim::Mismatch:
+                send_response(req, res, {422, json{{"status", "error"}, {"message", "Idempotency-Key was already used for a different booking."}}.dump()});
+                return;
+            case IdempotencyCache::Claim::InFlight:
+                return;
+            case IdempotencyCache::Claim::Replay:
+                send_response(req, res, stored, true);
+                return;
+            case IdempotencyCache::Claim::Owner:
+                break;
+        }
+
+        // Not in memory (restart or eviction): the key may still have been committed.
+        // An empty result (code 0) means it wasn't.
+        run_on_db(DbPriority::Checkout, [=](sqlite3* db) {
+            StoredResponse result;
+            load_idempotent_response(db, userId, idempotency_key, fingerprint, result);
+            return result;
+        }, [=, &req, &res](const StoredResponse& committed) {
+            if (committed.code != 0) {
+                // A failed lookup (DB busy or broken) is not remembered.
+                bool replayed = committed.code < 500;
+                idempotency_cache.complete(cache_key, committed, replayed);
+                send_response(req, res, committed, replayed);
+                return;
+            }
+            book_tickets(showtimeId, userId, seats, hold_id, idempotency_key, fingerprint, [=, &req, &res](const StoredResponse& result) {
+                // Seat conflicts and server errors never reach IdempotencyKeys, so
+                // they aren't remembered either: a retry, on any worker, tries again.
+                idempotency_cache.complete(cache_key, result, idempotency_persisted(result));
+                send_response(req, res, result);
+            });
+        });
+    });
+// A user's bookings, newest first, one entry per booking (not per seat):
+//   /users/7/bookings?limit=10&before=<booking_id>
+// Needs "Authorization: Bearer <token>" from /login for that same user.
+// "next_before" is the cursor for the next page, null on the last one.
+CROW_ROUTE(app, "/users/<int>/bookings")
+([](const crow::request& req, crow::response& res, int user_id){
+    std::string token = bearer_token(req);
+    int limit = 10;
+    sqlite3_int64 before = std::numeric_limits<sqlite3_int64>::max();
+    if (!int_param(req, "limit", limit) || !int_param(req, "before", before)) limit = 0;
+    if (limit < 1 || limit > MAX_HISTORY_PAGE) {
+        send_response(req, res, {400, "Invalid limit or before parameter"});
+        return;
+    }
+
+    respond_from_db(req, res, DbPriority::Account, HISTORY_QUERY_TIMEOUT, [=](sqlite3* db) -> StoredResponse {
+        int caller = authenticated_user(db, token);
+        if (!caller) return {401, json{{"status", "error"}, {"message", "Please log in again."}}.dump()};
+        if (caller != user_id) return {403, json{{"status", "error"}, {"message", "Not your bookings."}}.dump()};
+
+        // Pick the page's bookings first, then read their seats.
+        std::vector<sqlite3_int64> order_ids;
         sqlite3_stmt* stmt;
+        const char* sql_orders = "SELECT OrderID FROM BookingHeaders WHERE UserID = ? AND OrderID < ? ORDER BY OrderID DESC LIMIT ?";
+        if (sqlite3_prepare_v2(db, sql_orders, -1, &stmt, 0) != SQLITE_OK) return {500, "Database query failed"};
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_int64(stmt, 2, before);
+        sqlite3_bind_int(stmt, 3, limit + 1);
+        while (sqlite3_step(stmt) == SQLITE_ROW) order_ids.push_back(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
 
-        for (const auto& seat : seats) {
-            sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-            sqlite3_bind_int(stmt, 1, showtimeId);
-            sqlite3_bind_int(stmt, 2, userId);
-            sqlite3_bind_text(stmt, 3, seat.get<std::string>().c_str(), -1, SQLITE_STATIC);
-            
-            if (sqlite3_step(stmt) != SQLITE_DONE) {
-                std::cerr << "SQL error (Booking Insert): " << sqlite3_errmsg(db) << std::endl;
-                sqlite3_finalize(stmt);
-                return crow::response(500, "Failed to book one or more seats.");
+        bool has_more = static_cast<int>(order_ids.size()) > limit;
+        if (has_more) order_ids.resize(limit);
+
+        json bookings = json::array();
+        if (!order_ids.empty()) {
+            const char* sql_seats = "SELECT H.OrderID, H.ShowtimeID, S.SeatIndex FROM BookingHeaders AS H "
+                                    "JOIN BookingSeats AS S ON S.OrderID = H.OrderID "
+                                    "WHERE H.UserID = ? AND H.OrderID BETWEEN ? AND ? ORDER BY H.OrderID DESC, S.SeatIndex";
+            if (sqlite3_prepare_v2(db, sql_seats, -1, &stmt, 0) != SQLITE_OK) return {500, "Database query failed"};
+            sqlite3_bind_int(stmt, 1, user_id);
+            sqlite3_bind_int64(stmt, 2, order_ids.back());
+            sqlite3_bind_int64(stmt, 3, order_ids.front());
+            std::unordered_map<int, SeatLayout> layouts;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                sqlite3_int64 order_id = sqlite3_column_int64(stmt, 0);
+                int showtime_id = sqlite3_column_int(stmt, 1);
+                if (bookings.empty() || bookings.back()["booking_id"] != order_id) {
+                    bookings.push_back({{"booking_id", order_id}, {"showtime_id", showtime_id}, {"seats", json::array()}});
+                }
+                if (!layouts.count(showtime_id)) load_showtime_layout(db, showtime_id, layouts[showtime_id]);
+                // Seats of a showtime whose layout can't be read have no name to show.
+                std::string seat = seat_identifier(layouts[showtime_id], sqlite3_column_int(stmt, 2));
+                if (!seat.empty()) bookings.back()["seats"].push_back(seat);
             }
             sqlite3_finalize(stmt);
         }
 
-        return crow::response(200, json{{"status", "success"}, {"message", "Booking confirmed!"}}.dump());
+        auto catalog = load_catalog(db);
+        if (!catalog) return {500, "Database query failed"};
+        const char* sql_showtime = "SELECT MovieID, VenueID, AuditoriumID, substr(ShowtimeDateTime, 1, 10), strftime('%H:%M', ShowtimeDateTime) "
+                                   "FROM Showtimes WHERE ShowtimeID = ?";
+        if (sqlite3_prepare_v2(db, sql_showtime, -1, &stmt, 0) != SQLITE_OK) return {500, "Database query failed"};
+        for (auto& booking : bookings) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, booking["showtime_id"].get<int>());
+            if (sqlite3_step(stmt) != SQLITE_ROW) continue;
+            int movie_id = sqlite3_column_int(stmt, 0);
+            int venue_id = sqlite3_column_int(stmt, 1);
+            const MovieSummary* movie = catalog->movie(movie_id);
+            const VenueSummary* venue = catalog->venue(venue_id);
+            booking["movie_id"] = movie_id;
+            booking["title"] = movie ? json(movie->title) : json(nullptr);
+            booking["poster_url"] = movie ? json(movie->poster_url) : json(nullptr);
+            booking["venue_id"] = venue_id;
+            booking["venue_name"] = venue ? json(venue->name) : json(nullptr);
+            booking["auditorium_id"] = sqlite3_column_int(stmt, 2);
+            booking["date"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            booking["time"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        }
+        sqlite3_finalize(stmt);
+
+        json response;
+        response["bookings"] = bookings;
+        response["next_before"] = has_more ? json(order_ids.back()) : json(nullptr);
+        return {200, response.dump()};
+    });
+});
+
+// Cancels one of the caller's bookings (booking_id from /book-tickets or
+// /users/<id>/bookings). The seats are bookable again as soon as it returns.
+CROW_ROUTE(app, "/bookings/<int>/cancel").methods("POST"_method)
+([](const crow::request& req, crow::response& res, int booking_id){
+    std::string token = bearer_token(req);
+    struct Found
+    {
+        int user_id = 0;
+        int showtime_id = 0;
+        std::vector<std::string> seats;
+    };
+    auto found = std::make_shared<Found>();
+
+    // Code 0 means the booking was found and belongs to the caller.
+    run_on_db(DbPriority::Checkout, [=](sqlite3* db) -> StoredResponse {
+        found->user_id = authenticated_user(db, token);
+        if (!found->user_id) return {401, json{{"status", "error"}, {"message", "Please log in again."}}.dump()};
+
+        sqlite3_stmt* stmt;
+        const char* sql = "SELECT H.ShowtimeID, S.SeatIndex FROM BookingHeaders AS H "
+                          "JOIN BookingSeats AS S ON S.OrderID = H.OrderID WHERE H.OrderID = ? AND H.UserID = ?";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return {500, "Database query failed"};
+        sqlite3_bind_int64(stmt, 1, booking_id);
+        sqlite3_bind_int(stmt, 2, found->user_id);
+        SeatLayout layout;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (found->seats.empty()) {
+                found->showtime_id = sqlite3_column_int(stmt, 0);
+                load_showtime_layout(db, found->showtime_id, layout);
+                if (layout.seats_per_row() == 0) {
+                    sqlite3_finalize(stmt);
+                    log_error("booking's showtime has no seat layout", {{"booking_id", booking_id}, {"showtime_id", found->showtime_id}});
+                    return {500, "Failed to cancel the booking."};
+                }
+            }
+            found->seats.push_back(seat_identifier(layout, sqlite3_column_int(stmt, 1)));
+        }
+        sqlite3_finalize(stmt);
+        if (found->seats.empty()) return {404, json{{"status", "error"}, {"message", "Booking not found."}}.dump()};
+        return {0, ""};
+    }, [=, &req, &res](const StoredResponse& result) {
+        if (result.code != 0) {
+            send_response(req, res, result);
+            return;
+        }
+        cancel_booking(found->showtime_id, booking_id, found->user_id, found->seats,
+                       [&req, &res](const StoredResponse& response) { send_response(req, res, response); });
+    });
+});
+
+// Long poll for seat map changes: answers with {"version", "occupied"} once
+// the showtime's seats differ from `version`, or after SEAT_WATCH_TIMEOUT with
+// the same version. Without `version` it answers straight away.
+CROW_ROUTE(app, "/seat-updates")
+([](const crow::request& req, crow::response& res){
+    uint64_t since = std::numeric_limits<uint64_t>::max();
+    int showtimeId = 0;
+    if (!req.url_params.get("showtime_id") || !int_param(req, "showtime_id", showtimeId) || !int_param(req, "version", since)) {
+        send_response(req, res, {400, "Missing or invalid showtime_id or version parameter"});
+        return;
+    }
+
+    seat_inventory->post(showtimeId, [=, &req, &res](InventoryShard& shard) {
+        shard.watch(showtimeId, since, SEAT_WATCH_TIMEOUT, [showtimeId, &shard, &req, &res](ShowtimeSeats* showtime) {
+            if (showtime) showtime = shard.expire_holds(showtimeId);
+            if (!showtime) {
+                send_response(req, res, {404, "Showtime not found"});
+                return;
+            }
+            json occupied = json::array();
+            for (int index = 0; index < showtime->layout().seat_count(); ++index) {
+                if (!showtime->is_available(index)) occupied.push_back(showtime->seat_identifier(index));
+            }
+            send_response(req, res, {200, json{{"version", showtime->version()}, {"occupied", occupied}}.dump()});
+        });
     });
+});
+
 CROW_ROUTE(app, "/occupied-seats")
-    ([](const crow::request& req){
-        auto showtime_id_str = req.url_params.get("showtime_id");
-        if (!showtime_id_str) {
-            return crow::response(400, "Missing showtime_id parameter");
+    ([](const crow::request& req, crow::response& res){
+        int showtimeId = 0;
+        if (!req.url_params.get("showtime_id") || !int_param(req, "showtime_id", showtimeId)) {
+            send_response(req, res, {400, "Missing showtime_id parameter"});
+            return;
         }
 
-        json occupied_seats = json::array();
-        sqlite3_stmt* stmt;
-        const char* sql = "SELECT SeatIdentifier FROM Bookings WHERE ShowtimeID = ?";
+        occupied_seats_flight.run(occupied_seats_key(showtimeId), [showtimeId](SingleFlight<StoredResponse>::Callback done) {
+            // Seats held by /best-available show as occupied to everyone else.
+            seat_inventory->post(showtimeId, [showtimeId, done](InventoryShard& shard) {
+                json seats = json::array();
+                ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+                if (showtime) {
+                    for (int index = 0; index < showtime->layout().seat_count(); ++index) {
+                        if (!showtime->is_available(index)) seats.push_back(showtime->seat_identifier(index));
+                    }
+                }
+                done(StoredResponse{200, seats.dump()});
+            });
+        }, [&req, &res](const StoredResponse& result) { send_response(req, res, result); });
+    });
 
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
-            sqlite3_bind_int(stmt, 1, std::stoi(showtime_id_str));
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                occupied_seats.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    // Picks the best block of adjacent seats for a party and optionally holds it
+    // so the client can go straight to /book-tickets with the returned hold_id.
+    CROW_ROUTE(app, "/best-available").methods("POST"_method)
+    ([](const crow::request& req, crow::response& res){
+        auto j = json::parse(req.body, nullptr, false);
+        if (j.is_discarded() || !j.contains("showtime_id") || !j.contains("party_size")) {
+            send_response(req, res, {400, json{{"status", "error"}, {"message", "showtime_id and party_size are required."}}.dump()});
+            return;
+        }
+        int showtimeId = j["showtime_id"];
+        int party_size = j["party_size"];
+        std::string preference = j.value("preference", "any"); // "premium", "normal" or "any"
+        bool center_bias = j.value("center_bias", true);
+        bool hold = j.value("hold", false);
+
+        if (party_size < 1 || party_size > 8) {
+            send_response(req, res, {400, json{{"status", "error"}, {"message", "party_size must be between 1 and 8."}}.dump()});
+            return;
+        }
+        SeatClass seat_class = SeatClass::Any;
+        if (preference == "premium") seat_class = SeatClass::Premium;
+        else if (preference == "normal") seat_class = SeatClass::Normal;
+
+        std::string hold_id = hold ? generate_session_token() : "";
+        // Searching and holding run back to back on the owning shard, so nothing
+        // can take the block in between.
+        seat_inventory->post(showtimeId, [=, &req, &res](InventoryShard& shard) {
+            ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+            if (!showtime) {
+                send_response(req, res, {404, json{{"status", "error"}, {"message", "Showtime not found."}}.dump()});
+                return;
+            }
+            std::vector<int> block = showtime->find_best_block(party_size, seat_class, center_bias);
+            if (block.empty()) {
+                send_response(req, res, {404, json{{"status", "error"}, {"message", "No block of adjacent seats is available."}}.dump()});
+                return;
             }
+
+            json res_json;
+            res_json["status"] = "success";
+            res_json["seats"] = json::array();
+            for (int index : block) res_json["seats"].push_back(showtime->seat_identifier(index));
+            res_json["premium"] = showtime->is_premium(block.front());
+
+            if (!hold_id.empty()) {
+                showtime->add_hold(hold_id, block, SEAT_HOLD_TTL);
+                res_json["hold_id"] = hold_id;
+                res_json["hold_expires_in"] = std::chrono::duration_cast<std::chrono::seconds>(SEAT_HOLD_TTL).count();
+                occupied_seats_flight.invalidate(occupied_seats_key(showtimeId));
+            }
+            send_response(req, res, {200, res_json.dump()});
+        });
+    });
+
+    // Joins the waitlist of a (sold out) showtime. When a block of adjacent
+    // seats for the party comes free it is held for WAITLIST_OFFER_TTL and shows
+    // up as an offer on GET /waitlist/<showtime_id>/<waitlist_id>; the party
+    // books it with /book-tickets and the offer's hold_id.
+    CROW_ROUTE(app, "/waitlist").methods("POST"_method)
+    ([](const crow::request& req, crow::response& res){
+        auto j = json::parse(req.body, nullptr, false);
+        if (j.is_discarded() || !j.contains("showtime_id") || !j.contains("party_size")) {
+            send_response(req, res, {400, json{{"status", "error"}, {"message", "showtime_id and party_size are required."}}.dump()});
+            return;
         }
-        sqlite3_finalize(stmt);
+        int showtimeId = j["showtime_id"];
+        int party_size = j["party_size"];
+        std::string preference = j.value("preference", "any");
+        if (party_size < 1 || party_size > 8) {
+            send_response(req, res, {400, json{{"status", "error"}, {"message", "party_size must be between 1 and 8."}}.dump()});
+            return;
+        }
+        SeatClass seat_class = SeatClass::Any;
+        if (preference == "premium") seat_class = SeatClass::Premium;
+        else if (preference == "normal") seat_class = SeatClass::Normal;
+
+        std::string token = bearer_token(req);
+        auto user_id = std::make_shared<int>(0);
+        run_on_db(DbPriority::Checkout, [=](sqlite3* db) -> StoredResponse {
+            *user_id = authenticated_user(db, token);
+            if (!*user_id) return {401, json{{"status", "error"}, {"message", "Please log in again."}}.dump()};
+            return {0, ""};
+        }, [=, &req, &res](const StoredResponse& result) {
+            if (result.code != 0) {
+                send_response(req, res, result);
+                return;
+            }
+            seat_inventory->post(showtimeId, [=, &req, &res](InventoryShard& shard) {
+                ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+                if (!showtime) {
+                    send_response(req, res, {404, json{{"status", "error"}, {"message", "Showtime not found."}}.dump()});
+                    return;
+                }
+                ShowtimeWaitlist& list = waitlists[shard.index()][showtimeId];
+                if (list.waiting() >= MAX_WAITLIST) {
+                    send_response(req, res, {409, json{{"status", "error"}, {"message", "The waitlist for this showtime is full."}}.dump()});
+                    return;
+                }
+                std::string waitlist_id = list.join(generate_session_token(), *user_id, party_size, seat_class).id;
+                // Seats may already be free (or the party may be first in line
+                // for ones freed meanwhile), so offer straight away.
+                match_waitlist(shard, showtimeId);
+                const ShowtimeWaitlist& current = waitlists[shard.index()][showtimeId];
+                send_response(req, res, {200, waitlist_entry_json(showtimeId, *current.find(waitlist_id), current, *showtime).dump()});
+            });
+        });
+    });
 
-        return crow::response(200, occupied_seats.dump());
+    CROW_ROUTE(app, "/waitlist/<int>/<string>")
+    ([](const crow::request& req, crow::response& res, int showtimeId, std::string waitlist_id){
+        seat_inventory->post(showtimeId, [=, &req, &res](InventoryShard& shard) {
+            ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+            auto& lists = waitlists[shard.index()];
+            auto it = lists.find(showtimeId);
+            const WaitlistEntry* entry = nullptr;
+            if (showtime && it != lists.end()) {
+                it->second.settle(*showtime);
+                entry = it->second.find(waitlist_id);
+            }
+            if (!entry) {
+                send_response(req, res, {404, json{{"status", "error"}, {"message", "Waitlist entry not found."}}.dump()});
+                return;
+            }
+            send_response(req, res, {200, waitlist_entry_json(showtimeId, *entry, it->second, *showtime).dump()});
+        });
+    });
+
+    // Leaves the waitlist; an outstanding offer is passed on to the next party.
+    CROW_ROUTE(app, "/waitlist/<int>/<string>/leave").methods("POST"_method)
+    ([](const crow::request& req, crow::response& res, int showtimeId, std::string waitlist_id){
+        seat_inventory->post(showtimeId, [=, &req, &res](InventoryShard& shard) {
+            ShowtimeSeats* showtime = shard.expire_holds(showtimeId);
+            auto& lists = waitlists[shard.index()];
+            auto it = lists.find(showtimeId);
+            const WaitlistEntry* entry = showtime && it != lists.end() ? it->second.find(waitlist_id) : nullptr;
+            if (!entry) {
+                send_response(req, res, {404, json{{"status", "error"}, {"message", "Waitlist entry not found."}}.dump()});
+                return;
+            }
+            std::vector<int> freed = it->second.leave(waitlist_id, *showtime);
+            send_response(req, res, {200, json{{"status", "success"}}.dump()});
+            if (!freed.empty()) {
+                occupied_seats_flight.invalidate(occupied_seats_key(showtimeId));
+                shard.seats_released(showtimeId, freed);
+            }
+        });
+    });
+
+    // Prometheus scrape endpoint: DB queue depth and wait times, request coalescing.
+    metrics().gauge_fn("http_requests_in_flight", "Requests received but not yet answered",
+                       [] { return static_cast<double>(RequestTracker::in_flight().load()); });
+    metrics().gauge_fn("showtimes_flight_executions", "Showtimes queries actually run",
+                       [] { return static_cast<double>(showtimes_flight.executions()); });
+    metrics().gauge_fn("showtimes_flight_coalesced", "Showtimes requests served by a shared or cached query",
+                       [] { return static_cast<double>(showtimes_flight.coalesced()); });
+    metrics().gauge_fn("occupied_seats_flight_executions", "Occupied-seat lookups actually run",
+                       [] { return static_cast<double>(occupied_seats_flight.executions()); });
+    metrics().gauge_fn("occupied_seats_flight_coalesced", "Occupied-seat requests served by a shared or cached lookup",
+                       [] { return static_cast<double>(occupied_seats_flight.coalesced()); });
+    // Liveness: the process is up and its I/O threads answer.
+    CROW_ROUTE(app, "/healthz")
+    ([](){
+        crow::response res(200, json{{"status", "ok"}}.dump());
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Readiness: 200 once the warm-up has finished, 503 before that and while
+    // draining, so a load balancer only sends traffic to a warm instance.
+    CROW_ROUTE(app, "/readyz")
+    ([](){
+        bool draining = RequestTracker::draining().load();
+        bool ready = warm_up.ready() && !draining;
+        json body{{"status", ready ? "ready" : draining ? "draining" : "warming_up"},
+                  {"warmup_seconds", warm_up.elapsed_seconds()}, {"stages", warm_up.status()}};
+        crow::response res(ready ? 200 : 503, body.dump());
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    CROW_ROUTE(app, "/metrics")
+    ([](){
+        crow::response res(200, metrics().render());
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    });
+
+    // Recent spans of sampled requests as Chrome trace-event JSON; save it and
+    // open it in chrome://tracing or ui.perfetto.dev. ?trace_id=N keeps one
+    // request (its id is in the X-Trace-Id response header).
+    CROW_ROUTE(app, "/debug/traces")
+    ([](const crow::request& req){
+        uint64_t only = 0;
+        if (!int_param(req, "trace_id", only)) return crow::response(400, "trace_id must be a number");
+        crow::response res(200, Tracer::instance().chrome_json(only));
+        res.set_header("Content-Type", "application/json");
+        return res;
     });
 
     // --- Run the app ---
-    std::cout << "Server starting on port 18080..." << std::endl;
-    app.port(18080).multithreaded().bindaddr("0.0.0.0").run();
+    log_info("server starting", {{"port", options.port}});
+    app.port(options.port).multithreaded().bindaddr("0.0.0.0").reuse_port(supervised);
+#ifndef _WIN32
+    // Shutdown signals are ours to handle (gracefully), not Crow's.
+    app.signal_clear();
+    std::thread drainer([&app] { drain_on_shutdown_signal(app); });
+    // Workers share the port, so the kernel would hand a cold worker its
+    // share of connections as soon as it listens; they wait for the warm-up.
+    if (supervised) warm_up.wait();
+    auto server = app.run_async();
+    if (app.wait_for_server_start() == std::cv_status::no_timeout) notify_ready(options.ready_fd);
+    int exit_code = 0;
+    try {
+        server.get();
+    } catch (const std::exception& e) {
+        log_error("server failed", {{"error", e.what()}});
+        exit_code = 1;
+    }
+    pthread_kill(drainer.native_handle(), SIGTERM); // wakes it if the server died on its own
+    drainer.join();
+#else
+    app.run();
+    int exit_code = 0;
+#endif
+
+    db_executor.reset(); // finishes queued queries before the shards go away
+    hot_showtimes.stop();
+    seat_snapshotter.stop(); // writes a last snapshot for the next start
+    seat_inventory.reset(); // flushes any queued writes
 
     sqlite3_close(db);
-    return 0;
+    slow_query_log().stop();
+    logger().stop();
+    return exit_code;
 }
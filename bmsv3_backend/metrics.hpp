@@ -0,0 +1,177 @@
+#pragma once
+
+// Process-wide counters, gauges and histograms, rendered in the Prometheus
+// text format by the /metrics route. Updates are single atomic operations so
+// they are safe to call from request, shard and DB threads alike.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class Counter
+{
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge
+{
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Cumulative histogram over fixed upper bounds, in seconds.
+class Histogram
+{
+public:
+    explicit Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)), counts_(bounds_.size() + 1) {}
+
+    void observe(double seconds)
+    {
+        size_t i = 0;
+        while (i < bounds_.size() && seconds > bounds_[i]) ++i;
+        counts_[i].fetch_add(1, std::memory_order_relaxed);
+        sum_micros_.fetch_add(static_cast<uint64_t>(seconds * 1e6), std::memory_order_relaxed);
+    }
+
+    void render(std::ostream& out, const std::string& name, const std::string& labels) const
+    {
+        uint64_t cumulative = 0;
+        std::string sep = labels.empty() ? "" : ",";
+        for (size_t i = 0; i < bounds_.size(); ++i) {
+            cumulative += counts_[i].load(std::memory_order_relaxed);
+            out << name << "_bucket{" << labels << sep << "le=\"" << bounds_[i] << "\"} " << cumulative << "\n";
+        }
+        cumulative += counts_.back().load(std::memory_order_relaxed);
+        out << name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << cumulative << "\n";
+        std::string braces = labels.empty() ? "" : "{" + labels + "}";
+        out << name << "_sum" << braces << " " << sum_micros_.load(std::memory_order_relaxed) / 1e6 << "\n";
+        out << name << "_count" << braces << " " << cumulative << "\n";
+    }
+
+    static std::vector<double> latency_buckets()
+    {
+        return {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5};
+    }
+
+private:
+    std::vector<double> bounds_;
+    std::vector<std::atomic<uint64_t>> counts_;
+    std::atomic<uint64_t> sum_micros_{0};
+};
+
+class MetricsRegistry
+{
+public:
+    // `labels` is the inside of the braces, e.g. route="/movies". The same
+    // name + labels always returns the same metric.
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "")
+    {
+        return get(counters_, name, help, labels, "counter", [] { return std::make_unique<Counter>(); });
+    }
+
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "")
+    {
+        return get(gauges_, name, help, labels, "gauge", [] { return std::make_unique<Gauge>(); });
+    }
+
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                         std::vector<double> bounds = Histogram::latency_buckets())
+    {
+        return get(histograms_, name, help, labels, "histogram", [&] { return std::make_unique<Histogram>(bounds); });
+    }
+
+    // Value read at scrape time, for state that already has its own counter.
+    void gauge_fn(const std::string& name, const std::string& help, std::function<double()> fn, const std::string& labels = "")
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        describe(name, help, "gauge");
+        gauge_fns_[name][labels] = std::move(fn);
+    }
+
+    std::string render()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        for (const auto& family : families_) {
+            const std::string& name = family.first;
+            out << "# HELP " << name << " " << family.second.help << "\n";
+            out << "# TYPE " << name << " " << family.second.type << "\n";
+            render_simple(out, name, counters_);
+            render_simple(out, name, gauges_);
+            auto fns = gauge_fns_.find(name);
+            if (fns != gauge_fns_.end()) {
+                for (const auto& m : fns->second) out << name << braces(m.first) << " " << m.second() << "\n";
+            }
+            auto hist = histograms_.find(name);
+            if (hist != histograms_.end()) {
+                for (const auto& m : hist->second) m.second->render(out, name, m.first);
+            }
+        }
+        return out.str();
+    }
+
+private:
+    struct Family
+    {
+        std::string help;
+        std::string type;
+    };
+
+    template <class T>
+    using Store = std::map<std::string, std::map<std::string, std::unique_ptr<T>>>;
+
+    template <class T, class Make>
+    T& get(Store<T>& store, const std::string& name, const std::string& help, const std::string& labels,
+           const char* type, Make make)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        describe(name, help, type);
+        auto& slot = store[name][labels];
+        if (!slot) slot = make();
+        return *slot;
+    }
+
+    void describe(const std::string& name, const std::string& help, const char* type)
+    {
+        if (!families_.count(name)) families_[name] = Family{help, type};
+    }
+
+    template <class T>
+    static void render_simple(std::ostream& out, const std::string& name, const Store<T>& store)
+    {
+        auto it = store.find(name);
+        if (it == store.end()) return;
+        for (const auto& m : it->second) out << name << braces(m.first) << " " << m.second->value() << "\n";
+    }
+
+    static std::string braces(const std::string& labels) { return labels.empty() ? "" : "{" + labels + "}"; }
+
+    std::mutex mutex_;
+    std::map<std::string, Family> families_;
+    Store<Counter> counters_;
+    Store<Gauge> gauges_;
+    Store<Histogram> histograms_;
+    std::map<std::string, std::map<std::string, std::function<double()>>> gauge_fns_;
+};
+
+inline MetricsRegistry& metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Time limits and cancellation for read queries, enforced from inside SQLite.
+// While a guarded job runs, its DB thread's connection has a progress handler
+// that SQLite calls every few hundred VM instructions; once the route's time
+// limit is up, or the request has been cancelled because its client hung up,
+// the handler makes the running statement fail with SQLITE_INTERRUPT and the
+// DB thread is free for the next job instead of finishing work nobody will
+// read. Aborted queries are counted in db_queries_aborted_total by reason.
+
+#include <atomic>
+#include <chrono>
+#include <sqlite3.h>
+#include "metrics.hpp"
+
+class QueryGuard
+{
+public:
+    enum class Abort
+    {
+        None,
+        Deadline,  // ran past its route's time limit
+        Cancelled, // the client went away
+    };
+
+    // VM instructions between checks; a check is a clock read, so this is
+    // well under a microsecond of overhead per thousand steps.
+    static constexpr int CHECK_EVERY = 1000;
+
+    explicit QueryGuard(std::chrono::milliseconds timeout) : timeout_(timeout) {}
+
+    // Any thread. A query not yet started doesn't run; a running one stops at
+    // its next check.
+    void cancel() { cancelled_.store(true); }
+    bool cancelled() const { return cancelled_.load(); }
+
+    // Set once the job is over (run, aborted or never run), so whoever is
+    // watching the client can stop.
+    void finish() { finished_.store(true); }
+    bool finished() const { return finished_.load(); }
+
+    Abort aborted() const { return aborted_; }
+
+    // Installs the handler on `db` for the scope's lifetime; the time limit
+    // counts from here.
+    class Scope
+    {
+    public:
+        Scope(sqlite3* db, QueryGuard& guard) : db_(db)
+        {
+            guard.deadline_ = std::chrono::steady_clock::now() + guard.timeout_;
+            sqlite3_progress_handler(db_, CHECK_EVERY, &QueryGuard::check, &guard);
+        }
+        ~Scope() { sqlite3_progress_handler(db_, 0, nullptr, nullptr); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        sqlite3* db_;
+    };
+
+    // Counts the abort, if there was one; call once the job is done.
+    void count_abort() const
+    {
+        static Counter& deadline = metrics().counter("db_queries_aborted_total", "Queries interrupted before they finished",
+                                                     "reason=\"deadline\"");
+        static Counter& cancelled = metrics().counter("db_queries_aborted_total", "Queries interrupted before they finished",
+                                                      "reason=\"client_gone\"");
+        if (aborted_ == Abort::Deadline) deadline.inc();
+        else if (aborted_ == Abort::Cancelled) cancelled.inc();
+    }
+
+    // For a job dropped before it ran because the client had already gone.
+    void abort_unrun()
+    {
+        aborted_ = Abort::Cancelled;
+        count_abort();
+    }
+
+private:
+    // Non-zero interrupts the statement.
+    static int check(void* arg)
+    {
+        auto* guard = static_cast<QueryGuard*>(arg);
+        if (guard->cancelled_.load(std::memory_order_relaxed)) {
+            guard->aborted_ = Abort::Cancelled;
+            return 1;
+        }
+        if (std::chrono::steady_clock::now() > guard->deadline_) {
+            guard->aborted_ = Abort::Deadline;
+            return 1;
+        }
+        return 0;
+    }
+
+    std::chrono::milliseconds timeout_;
+    std::chrono::steady_clock::time_point deadline_{};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> finished_{false};
+    Abort aborted_ = Abort::None; // DB thread only
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+// Crow middlewares that see every request. Include after crow.h.
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "tracing.hpp"
+
+// Counts requests which have arrived but not yet been answered, so a worker
+// that was asked to stop knows when it has drained. While draining, responses
+// carry "Connection: close" so keep-alive clients move over to the workers
+// that are still accepting.
+//
+// Crow answers a request that matches no route by calling after_handle without
+// before_handle, on the connection's previous context, so each middleware here
+// marks what its before_handle did and clears it once handled.
+struct RequestTracker
+{
+    struct context
+    {
+        bool counted = false;
+    };
+
+    void before_handle(crow::request&, crow::response&, context& ctx)
+    {
+        in_flight().fetch_add(1);
+        ctx.counted = true;
+    }
+
+    void after_handle(crow::request&, crow::response& res, context& ctx)
+    {
+        if (draining().load()) res.set_header("Connection", "close");
+        if (!ctx.counted) return;
+        ctx.counted = false;
+        in_flight().fetch_sub(1);
+    }
+
+    static std::atomic<int>& in_flight()
+    {
+        static std::atomic<int> count{0};
+        return count;
+    }
+
+    static std::atomic<bool>& draining()
+    {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+};
+
+// Decides whether a request is traced (see tracing.hpp)
+// and records the whole request as the root span. The trace id is made
+// current for the handler; work the handler hands to DB and shard threads
+// carries it from there. "X-Trace: 1" traces a request regardless of the
+// sample rate and the response names its trace in an X-Trace-Id header.
+struct RequestTracing
+{
+    struct context
+    {
+        uint64_t trace_id = 0;
+        int64_t start_us = 0;
+    };
+
+    void before_handle(crow::request& req, crow::response&, context& ctx)
+    {
+        ctx.trace_id = Tracer::instance().start_trace(req.get_header_value("X-Trace") == "1");
+        current_trace() = ctx.trace_id;
+        if (!ctx.trace_id) return;
+        ctx.start_us = Tracer::now_us();
+        trace_thread_name("http");
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx)
+    {
+        if (!ctx.trace_id) return;
+        {
+            TraceScope scope(ctx.trace_id);
+            trace_record("request", "http", ctx.start_us, Tracer::now_us(),
+                         std::string(crow::method_name(req.method)) + " " + req.raw_url + " -> " + std::to_string(res.code));
+        }
+        res.set_header("X-Trace-Id", std::to_string(ctx.trace_id));
+        ctx.trace_id = 0;
+        current_trace() = 0;
+    }
+};
+
+// One info record per answered request: method, route, status and latency
+// (and the trace id, for sampled requests). Listed after RequestTracing so the
+// trace is still current when it runs.
+struct AccessLog
+{
+    struct context
+    {
+        std::chrono::steady_clock::time_point start;
+        uint64_t trace_id = 0;
+    };
+
+    void before_handle(crow::request&, crow::response&, context& ctx)
+    {
+        ctx.start = std::chrono::steady_clock::now();
+        ctx.trace_id = current_trace();
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx)
+    {
+        TraceScope scope(ctx.trace_id);
+        auto start = ctx.start;
+        ctx = context();
+        if (!logger().enabled(LogLevel::Info)) return;
+        std::vector<LogField> fields{{"method", crow::method_name(req.method)}, {"route", req.url}, {"status", res.code}};
+        if (start != std::chrono::steady_clock::time_point()) {
+            fields.emplace_back("latency_ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        log_info("request", std::move(fields));
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+// Calendar helpers and the in-memory shape of a showtime schedule.
+// Dates are the "YYYY-MM-DD" prefix of Showtimes.ShowtimeDateTime; in memory
+// they are day numbers (days since 1970-01-01) so ranges are plain integers.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm).
+inline int days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Strict "YYYY-MM-DD"; rejects anything else, including impossible dates.
+inline bool parse_date(const std::string& text, int& day)
+{
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-') return false;
+    for (int i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+        if (text[i] < '0' || text[i] > '9') return false;
+    }
+    int y = std::stoi(text.substr(0, 4));
+    int m = std::stoi(text.substr(5, 2));
+    int d = std::stoi(text.substr(8, 2));
+    if (m < 1 || m > 12 || d < 1) return false;
+    static const int month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    if (d > month_days[m - 1] || (m == 2 && d == 29 && !leap)) return false;
+    day = days_from_civil(y, m, d);
+    return true;
+}
+
+inline std::string format_date(int day)
+{
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp + (mp < 10 ? 3 : -9);
+    int y = yoe + era * 400 + (m <= 2);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d", y, m, d);
+    return buf;
+}
+
+// The Monday on or before `day` (1970-01-01 was a Thursday).
+inline int week_start(int day)
+{
+    int weekday = ((day + 3) % 7 + 7) % 7; // 0 = Monday
+    return day - weekday;
+}
+
+struct VenueSummary
+{
+    int venue_id;
+    std::string name;
+    double rating;
+    std::string image_url;
+    std::string location;
+    bool has_coordinates = false;
+    double latitude = 0;
+    double longitude = 0;
+};
+
+struct ScheduledShowtime
+{
+    int showtime_id;
+    int movie_id;
+    int venue_id;
+    int auditorium_id;
+    int day;
+    std::string time; // "HH:MM"
+    int seats_remaining;
+    int premium_remaining;
+};
+
+// Everything one movie shows in one Monday-to-Sunday week. `showtimes` is
+// ordered by day, then venue, then time, which is the order the date strip
+// renders them in.
+struct MovieWeek
+{
+    int movie_id;
+    int first_day;
+    std::vector<ScheduledShowtime> showtimes;
+    std::vector<VenueSummary> venues;
+};
+
+// Every showtime at one venue, ordered by day, then movie, then time, so a
+// day range is one lower_bound and the movies of a day are contiguous.
+struct VenueSchedule
+{
+    int venue_id;
+    std::vector<ScheduledShowtime> showtimes;
+
+    std::vector<ScheduledShowtime>::const_iterator first_on_or_after(int day) const
+    {
+        return std::lower_bound(showtimes.begin(), showtimes.end(), day,
+                                [](const ScheduledShowtime& s, int d) { return s.day < d; });
+    }
+
+    // The first `count` showtimes starting at or after `time` ("HH:MM") on `day`.
+    std::vector<ScheduledShowtime> upcoming(int day, const std::string& time, size_t count) const
+    {
+        std::vector<ScheduledShowtime> result;
+        for (auto it = first_on_or_after(day); it != showtimes.end() && result.size() < count;) {
+            std::vector<ScheduledShowtime> same_day;
+            int current = it->day;
+            for (; it != showtimes.end() && it->day == current; ++it) {
+                if (current > day || it->time >= time) same_day.push_back(*it);
+            }
+            std::sort(same_day.begin(), same_day.end(),
+                      [](const ScheduledShowtime& a, const ScheduledShowtime& b) { return a.time < b.time; });
+            for (size_t i = 0; i < same_day.size() && result.size() < count; ++i) result.push_back(same_day[i]);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+// Server-side view of an auditorium's seat layout.
+// The Layout column in Auditoriums looks like:
+//   {"sections":[8, 12, 8], "premium_rows":1, "total_rows":10}
+// Seat identifiers are built the same way seats.js builds them: a row letter
+// followed by the seat number counted across all sections (e.g. "B14").
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include/json.hpp"
+
+struct SeatLayout
+{
+    std::vector<int> sections; // seats per section, left to right
+    int premium_rows = 0;      // the first N rows are premium
+    int total_rows = 8;        // same fallback seats.js uses
+
+    int seats_per_row() const
+    {
+        int n = 0;
+        for (int s : sections) n += s;
+        return n;
+    }
+
+    int seat_count() const { return total_rows * seats_per_row(); }
+    int premium_seat_count() const { return premium_rows * seats_per_row(); }
+};
+
+inline SeatLayout parse_seat_layout(const std::string& layout_json)
+{
+    SeatLayout layout;
+    nlohmann::json j = nlohmann::json::parse(layout_json, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) return layout;
+
+    // Sections that aren't a positive seat count are skipped, and the row
+    // counts are clamped to what row letters A-Z can name.
+    if (j.contains("sections") && j["sections"].is_array()) {
+        for (const auto& s : j["sections"]) {
+            if (s.is_number_integer() && s.get<int64_t>() > 0 && s.get<int64_t>() <= 9999) layout.sections.push_back(s.get<int>());
+        }
+    }
+    auto rows = [&j](const char* name, int fallback) {
+        return j.contains(name) && j[name].is_number_integer() ? std::max<int64_t>(0, std::min<int64_t>(26, j[name].get<int64_t>())) : fallback;
+    };
+    layout.total_rows = static_cast<int>(rows("total_rows", 8));
+    layout.premium_rows = std::min(static_cast<int>(rows("premium_rows", 0)), layout.total_rows);
+    return layout;
+}
+
+// "B14" -> row 1, seat 14. Returns false for anything outside the layout.
+inline bool parse_seat_identifier(const SeatLayout& layout, const std::string& seat_id, int& row, int& seat_number)
+{
+    if (seat_id.size() < 2 || seat_id[0] < 'A' || seat_id[0] > 'Z') return false;
+    row = seat_id[0] - 'A';
+    seat_number = 0;
+    for (size_t i = 1; i < seat_id.size(); ++i) {
+        if (seat_id[i] < '0' || seat_id[i] > '9') return false;
+        seat_number = seat_number * 10 + (seat_id[i] - '0');
+        if (seat_number > 9999) return false;
+    }
+    return row < layout.total_rows && seat_number >= 1 && seat_number <= layout.seats_per_row();
+}
+
+// Seats are stored by index: row * seats_per_row + (seat number - 1), which
+// is why the database refuses section changes once a showtime has bookings.
+// Returns -1 for anything outside the layout.
+inline int seat_index(const SeatLayout& layout, const std::string& seat_id)
+{
+    int row, seat_number;
+    if (!parse_seat_identifier(layout, seat_id, row, seat_number)) return -1;
+    return row * layout.seats_per_row() + seat_number - 1;
+}
+
+// An empty string if the layout has no seats (a missing or unreadable one).
+inline std::string seat_identifier(const SeatLayout& layout, int index)
+{
+    int per_row = layout.seats_per_row();
+    if (per_row == 0 || index < 0) return std::string();
+    return std::string(1, static_cast<char>('A' + index / per_row)) + std::to_string(index % per_row + 1);
+}
+
+inline bool is_premium_index(const SeatLayout& layout, int index)
+{
+    int per_row = layout.seats_per_row();
+    return per_row > 0 && index >= 0 && index / per_row < layout.premium_rows;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+// In-memory seat occupancy for one showtime. Not thread-safe: each instance is
+// owned by a single inventory shard (see inventory.hpp).
+// Every (row, section) pair gets ceil(width / 64) 64-bit masks, so finding a
+// free block of N adjacent seats is a few shifts and ANDs per mask instead of
+// walking seat identifiers. Blocks never span two sections, which is how the
+// aisles drawn by seats.js are respected.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "seat_layout.hpp"
+
+enum class SeatClass { Any, Premium, Normal };
+
+struct SeatHold
+{
+    std::string id;
+    std::vector<int> seats; // seat indices, see ShowtimeSeats::seat_index()
+    std::chrono::steady_clock::time_point expires_at;
+};
+
+class ShowtimeSeats
+{
+public:
+    explicit ShowtimeSeats(const SeatLayout& layout) : layout_(layout)
+    {
+        int start = 0, word = 0;
+        for (int width : layout_.sections) {
+            section_start_.push_back(start);
+            section_word_.push_back(word);
+            start += width;
+            word += (width + 63) / 64;
+        }
+        words_per_row_ = word;
+        booked_.assign(static_cast<size_t>(layout_.total_rows) * words_per_row_, 0);
+        held_.assign(booked_.size(), 0);
+    }
+
+    const SeatLayout& layout() const { return layout_; }
+
+    // See ::seat_index() in seat_layout.hpp; -1 if not in the layout.
+    int seat_index(const std::string& seat_id) const { return ::seat_index(layout_, seat_id); }
+    std::string seat_identifier(int index) const { return ::seat_identifier(layout_, index); }
+    bool is_premium(int index) const { return is_premium_index(layout_, index); }
+    bool is_booked(int index) const { return (booked_[mask_slot(index)] & mask_bit(index)) != 0; }
+    bool is_held(int index) const { return (held_[mask_slot(index)] & mask_bit(index)) != 0; }
+
+    void set_booked(int index, bool booked)
+    {
+        if (booked) booked_[mask_slot(index)] |= mask_bit(index);
+        else booked_[mask_slot(index)] &= ~mask_bit(index);
+        ++version_;
+    }
+
+    // Bumped by every change to which seats are booked or held, so watchers
+    // can tell whether their copy of the seat map is current.
+    uint64_t version() const { return version_; }
+    void set_version(uint64_t version) { version_ = version; }
+
+    // Free for this caller: not booked, and either not held or held under hold_id.
+    bool is_available(int index, const std::string& hold_id = "") const
+    {
+        if (is_booked(index)) return false;
+        if (!is_held(index)) return true;
+        const SeatHold* hold = find_hold(hold_id);
+        if (!hold) return false;
+        for (int seat : hold->seats) {
+            if (seat == index) return true;
+        }
+        return false;
+    }
+
+    const SeatHold* find_hold(const std::string& hold_id) const
+    {
+        if (hold_id.empty()) return nullptr;
+        for (const auto& hold : holds_) {
+            if (hold.id == hold_id) return &hold;
+        }
+        return nullptr;
+    }
+
+    void add_hold(const std::string& hold_id, const std::vector<int>& seats, std::chrono::steady_clock::duration ttl)
+    {
+        for (int seat : seats) held_[mask_slot(seat)] |= mask_bit(seat);
+        holds_.push_back({hold_id, seats, std::chrono::steady_clock::now() + ttl});
+        ++version_;
+    }
+
+    void release_hold(const std::string& hold_id)
+    {
+        for (size_t i = 0; i < holds_.size(); ++i) {
+            if (holds_[i].id != hold_id) continue;
+            for (int seat : holds_[i].seats) held_[mask_slot(seat)] &= ~mask_bit(seat);
+            holds_.erase(holds_.begin() + i);
+            ++version_;
+            return;
+        }
+    }
+
+    // Carries holds over from an older copy of this showtime's state (see
+    // InventoryShard's refresh). Holds on seats that have since been booked,
+    // or from a different layout, are dropped.
+    void adopt_holds(const ShowtimeSeats& older)
+    {
+        if (older.layout_.seats_per_row() != layout_.seats_per_row() || older.booked_.size() != booked_.size()) return;
+        for (const auto& hold : older.holds_) {
+            bool free = true;
+            for (int seat : hold.seats) free = free && !is_booked(seat);
+            if (!free) continue;
+            for (int seat : hold.seats) held_[mask_slot(seat)] |= mask_bit(seat);
+            holds_.push_back(hold);
+        }
+    }
+
+    bool same_occupancy(const ShowtimeSeats& other) const { return booked_ == other.booked_ && held_ == other.held_; }
+
+    // The booked seats as masks per (row, section), for seat snapshots.
+    const std::vector<uint64_t>& booked_masks() const { return booked_; }
+
+    // Takes the booked seats from masks saved by booked_masks(). False, with
+    // nothing changed, if the count doesn't match this layout.
+    bool load_booked_masks(const uint64_t* masks, size_t count)
+    {
+        if (count != booked_.size()) return false;
+        booked_.assign(masks, masks + count);
+        ++version_;
+        return true;
+    }
+
+    // Drops holds past their expiry and returns the seats that became free.
+    std::vector<int> expire_holds(std::chrono::steady_clock::time_point now)
+    {
+        std::vector<int> released;
+        for (size_t i = 0; i < holds_.size();) {
+            if (holds_[i].expires_at > now) {
+                ++i;
+                continue;
+            }
+            for (int seat : holds_[i].seats) {
+                held_[mask_slot(seat)] &= ~mask_bit(seat);
+                if (!is_booked(seat)) released.push_back(seat);
+            }
+            holds_.erase(holds_.begin() + i);
+            ++version_;
+        }
+        return released;
+    }
+
+    int available_count() const
+    {
+        int n = 0;
+        for (int row = 0; row < layout_.total_rows; ++row) {
+            for (size_t s = 0; s < layout_.sections.size(); ++s) {
+                for (int w = 0; w < section_words(s); ++w) {
+                    const size_t slot = static_cast<size_t>(row) * words_per_row_ + section_word_[s] + w;
+                    n += popcount(~(booked_[slot] | held_[slot]) & word_mask(s, w));
+                }
+            }
+        }
+        return n;
+    }
+
+    // Best block of party_size adjacent free seats, or an empty vector.
+    // With center_bias the block closest to the middle of the screen and to the
+    // middle of the eligible rows wins; without it, the front-left-most block does.
+    std::vector<int> find_best_block(int party_size, SeatClass seat_class, bool center_bias) const
+    {
+        std::vector<int> best;
+        const int sections = static_cast<int>(layout_.sections.size());
+        const int per_row = layout_.seats_per_row();
+        if (party_size < 1 || party_size > 64 || per_row == 0) return best;
+
+        int first_row = 0, last_row = layout_.total_rows;
+        if (seat_class == SeatClass::Premium) last_row = std::min(layout_.premium_rows, layout_.total_rows);
+        if (seat_class == SeatClass::Normal) first_row = std::min(layout_.premium_rows, layout_.total_rows);
+
+        const double ideal_row = (first_row + last_row - 1) / 2.0;
+        const double screen_center = (per_row - 1) / 2.0;
+        double best_score = 0;
+        int best_row = -1, best_start = -1;
+
+        for (int row = first_row; row < last_row; ++row) {
+            for (int s = 0; s < sections; ++s) {
+                const int words = section_words(s);
+                const size_t first = static_cast<size_t>(row) * words_per_row_ + section_word_[s];
+                for (int w = 0; w < words; ++w) {
+                    // A block starting in word w ends in it or the next one.
+                    const uint64_t free = ~(booked_[first + w] | held_[first + w]) & word_mask(s, w);
+                    const uint64_t next =
+                        w + 1 < words ? ~(booked_[first + w + 1] | held_[first + w + 1]) & word_mask(s, w + 1) : 0;
+
+                    // Bit j of starts is set when seats j .. j+party_size-1 are all free.
+                    uint64_t starts = free;
+                    for (int i = 1; i < party_size && starts; ++i) starts &= (free >> i) | (next << (64 - i));
+
+                    while (starts) {
+                        const int bit = ctz(starts);
+                        starts &= starts - 1;
+                        const int start = section_start_[s] + w * 64 + bit;
+                        double score;
+                        if (center_bias) {
+                            score = std::fabs(start + (party_size - 1) / 2.0 - screen_center) + 1.5 * std::fabs(row - ideal_row);
+                        } else {
+                            score = static_cast<double>(row) * per_row + start;
+                        }
+                        if (best_row < 0 || score < best_score) {
+                            best_score = score;
+                            best_row = row;
+                            best_start = start;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (best_row < 0) return best;
+        for (int i = 0; i < party_size; ++i) best.push_back(best_row * per_row + best_start + i);
+        return best;
+    }
+
+private:
+    SeatLayout layout_;
+    std::vector<int> section_start_;
+    std::vector<int> section_word_; // first mask of each section within a row
+    int words_per_row_ = 0;
+    std::vector<uint64_t> booked_;
+    std::vector<uint64_t> held_;
+    std::vector<SeatHold> holds_;
+    uint64_t version_ = 0;
+
+    int section_words(size_t section) const { return (layout_.sections[section] + 63) / 64; }
+
+    // The seats of `section` that word `w` of it covers.
+    uint64_t word_mask(size_t section, int w) const
+    {
+        int width = layout_.sections[section] - w * 64;
+        return width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+    }
+
+    // Section of a seat, and the seat's position from the section's left edge.
+    size_t seat_section(int index, int& offset) const
+    {
+        const int column = index % layout_.seats_per_row();
+        size_t s = section_start_.size() - 1;
+        while (s > 0 && column < section_start_[s]) --s;
+        offset = column - section_start_[s];
+        return s;
+    }
+
+    size_t mask_slot(int index) const
+    {
+        int offset;
+        size_t s = seat_section(index, offset);
+        return static_cast<size_t>(index / layout_.seats_per_row()) * words_per_row_ + section_word_[s] + offset / 64;
+    }
+
+    uint64_t mask_bit(int index) const
+    {
+        int offset;
+        seat_section(index, offset);
+        return uint64_t(1) << (offset % 64);
+    }
+
+    static int ctz(uint64_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(v);
+#else
+        int n = 0;
+        while (!(v & 1)) { v >>= 1; ++n; }
+        return n;
+#endif
+    }
+
+    static int popcount(uint64_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(v);
+#else
+        int n = 0;
+        for (; v; v &= v - 1) ++n;
+        return n;
+#endif
+    }
+};
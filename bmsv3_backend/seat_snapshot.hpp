@@ -0,0 +1,312 @@
+#pragma once
+
+// Seat-state snapshots for a warm restart. Every so often the inventory shards
+// copy the booked-seat masks of the showtimes they hold, each stamped with the
+// Showtimes.SeatsSeq it reflects (the sequence number every booking and
+// cancellation of the showtime moves on by one), and the lot is written to a
+// file that replaces the previous one by rename, so a crash mid-write leaves
+// the old snapshot intact. On startup the file is memory-mapped and every
+// showtime whose SeatsSeq still matches is installed straight from it; only
+// the ones booked or cancelled since are read back from BookingSeats.
+//
+// File layout (host byte order, all fields naturally aligned):
+//   header   magic "BMSEATS1", entry count, unused, unix ms written, checksum
+//   entries  showtime id (int32), mask count (uint32), SeatsSeq (uint64),
+//            layout hash (uint64), then that many uint64 booked masks
+// The checksum is FNV-1a over everything after the header.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "log.hpp"
+#include "metrics.hpp"
+#include "seat_layout.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+// One showtime's booked seats, as a shard hands them to the snapshot writer.
+struct SeatSnapshotEntry
+{
+    int showtime_id = 0;
+    uint64_t seq = 0;
+    uint64_t layout_hash = 0;
+    std::vector<uint64_t> booked; // ShowtimeSeats::booked_masks()
+};
+
+// One showtime's booked seats inside a mapped snapshot.
+struct SeatSnapshotView
+{
+    int showtime_id;
+    uint64_t seq;
+    uint64_t layout_hash;
+    const uint64_t* booked;
+    uint32_t mask_count;
+};
+
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Changes whenever a snapshot's masks would no longer line up with the layout.
+inline uint64_t layout_hash(const SeatLayout& layout)
+{
+    uint64_t hash = fnv1a(&layout.total_rows, sizeof(layout.total_rows));
+    hash = fnv1a(&layout.premium_rows, sizeof(layout.premium_rows), hash);
+    for (int width : layout.sections) hash = fnv1a(&width, sizeof(width), hash);
+    return hash;
+}
+
+namespace seat_snapshot_detail
+{
+constexpr char MAGIC[8] = {'B', 'M', 'S', 'E', 'A', 'T', 'S', '1'};
+
+struct Header
+{
+    char magic[8];
+    uint32_t entry_count;
+    uint32_t unused;
+    uint64_t written_ms;
+    uint64_t checksum;
+};
+
+struct EntryHeader
+{
+    int32_t showtime_id;
+    uint32_t mask_count;
+    uint64_t seq;
+    uint64_t layout_hash;
+};
+} // namespace seat_snapshot_detail
+
+// Writes `entries` to path.tmp.<pid>, syncs it and renames it over `path`.
+inline bool write_seat_snapshot(const std::string& path, const std::vector<SeatSnapshotEntry>& entries)
+{
+    using namespace seat_snapshot_detail;
+    std::string body;
+    for (const auto& entry : entries) {
+        EntryHeader h{entry.showtime_id, static_cast<uint32_t>(entry.booked.size()), entry.seq, entry.layout_hash};
+        body.append(reinterpret_cast<const char*>(&h), sizeof(h));
+        body.append(reinterpret_cast<const char*>(entry.booked.data()), entry.booked.size() * sizeof(uint64_t));
+    }
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.unused = 0;
+    header.written_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    header.checksum = fnv1a(body.data(), body.size());
+
+#ifndef _WIN32
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+#else
+    std::string tmp = path + ".tmp";
+#endif
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        log_error("can't write seat snapshot", {{"path", tmp}});
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (body.empty() || std::fwrite(body.data(), body.size(), 1, f) == 1) &&
+              std::fflush(f) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(f)) == 0; // the rename must not land before the data
+#endif
+    ok = std::fclose(f) == 0 && ok;
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename doesn't replace on Windows
+#endif
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        log_error("can't write seat snapshot", {{"path", path}});
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// A snapshot file mapped read-only. The views point into the mapping, so they
+// are only good while this object lives.
+class SeatSnapshot
+{
+public:
+    SeatSnapshot() = default;
+    SeatSnapshot(const SeatSnapshot&) = delete;
+    SeatSnapshot& operator=(const SeatSnapshot&) = delete;
+    ~SeatSnapshot() { close(); }
+
+    // False if there is no usable snapshot at `path`; a damaged one is logged.
+    bool open(const std::string& path)
+    {
+        using namespace seat_snapshot_detail;
+        close();
+        if (!map(path)) return false;
+        auto reject = [&](const char* why) {
+            log_warning("ignoring seat snapshot", {{"path", path}, {"reason", why}});
+            close();
+            return false;
+        };
+        if (size_ < sizeof(Header)) return reject("truncated");
+        Header header;
+        std::memcpy(&header, data_, sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return reject("not a seat snapshot");
+        if (fnv1a(data_ + sizeof(Header), size_ - sizeof(Header)) != header.checksum) return reject("checksum mismatch");
+
+        size_t offset = sizeof(Header);
+        views_.reserve(header.entry_count);
+        for (uint32_t i = 0; i < header.entry_count; ++i) {
+            if (size_ - offset < sizeof(EntryHeader)) return reject("truncated");
+            const auto* entry = reinterpret_cast<const EntryHeader*>(data_ + offset);
+            offset += sizeof(EntryHeader);
+            if ((size_ - offset) / sizeof(uint64_t) < entry->mask_count) return reject("truncated");
+            views_.push_back({entry->showtime_id, entry->seq, entry->layout_hash,
+                              reinterpret_cast<const uint64_t*>(data_ + offset), entry->mask_count});
+            offset += entry->mask_count * sizeof(uint64_t);
+        }
+        written_ms_ = header.written_ms;
+        return true;
+    }
+
+    const std::vector<SeatSnapshotView>& entries() const { return views_; }
+    uint64_t written_ms() const { return written_ms_; }
+
+private:
+#ifndef _WIN32
+    bool map(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        madvise(p, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+        data_ = static_cast<const char*>(p);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    void close()
+    {
+        if (data_) munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        views_.clear();
+    }
+#else
+    // No mmap here; the file is small enough to read whole, into uint64s so
+    // the masks are aligned for reading in place.
+    bool map(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return false;
+        size_t size = static_cast<size_t>(in.tellg());
+        if (size == 0) return false;
+        buffer_.assign((size + 7) / 8, 0);
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(buffer_.data()), size)) return false;
+        data_ = reinterpret_cast<const char*>(buffer_.data());
+        size_ = size;
+        return true;
+    }
+
+    void close()
+    {
+        buffer_.clear();
+        data_ = nullptr;
+        size_ = 0;
+        views_.clear();
+    }
+
+    std::vector<uint64_t> buffer_;
+#endif
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    uint64_t written_ms_ = 0;
+    std::vector<SeatSnapshotView> views_;
+};
+
+// Writes a snapshot every `interval` on its own thread, and once more on stop()
+// so a clean shutdown leaves an up-to-date file behind.
+class SeatSnapshotter
+{
+public:
+    using Collect = std::function<std::vector<SeatSnapshotEntry>()>;
+
+    ~SeatSnapshotter() { stop(); }
+
+    void start(std::string path, std::chrono::seconds interval, Collect collect)
+    {
+        path_ = std::move(path);
+        interval_ = interval;
+        collect_ = std::move(collect);
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        wake_.notify_one();
+        thread_.join();
+        write();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!wake_.wait_for(lock, interval_, [this] { return !running_; })) {
+            lock.unlock();
+            write();
+            lock.lock();
+        }
+    }
+
+    void write()
+    {
+        static Histogram& seconds = metrics().histogram("seat_snapshot_seconds", "Time to collect and write a seat-state snapshot");
+        static Gauge& showtimes = metrics().gauge("seat_snapshot_showtimes", "Showtimes in the last seat-state snapshot written");
+        auto started = std::chrono::steady_clock::now();
+        std::vector<SeatSnapshotEntry> entries = collect_();
+        if (!write_seat_snapshot(path_, entries)) return;
+        seconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        showtimes.set(static_cast<int64_t>(entries.size()));
+    }
+
+    std::string path_;
+    std::chrono::seconds interval_{60};
+    Collect collect_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+// Session tokens (from /login) and hold/waitlist ids: 32 random bytes in hex.
+// Shared with bench.cpp so the benchmark measures the code the server runs.
+
+#include <random>
+#include <sstream>
+#include <string>
+
+inline std::string generate_session_token() {
+    std::stringstream ss;
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> distrib(0, 255);
+    for (int i = 0; i < 32; ++i) {
+        ss << std::hex << distrib(gen);
+    }
+    return ss.str();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Request coalescing for read endpoints. Concurrent callers asking for the
+// same key share one execution of `produce`; with a non-zero TTL the result
+// is also kept as a microcache for that long after it was produced.
+// Everything is callback based so a waiting caller never blocks a thread.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+template <class V>
+class SingleFlight
+{
+public:
+    using Callback = std::function<void(const V&)>;
+    // Must call its argument exactly once, from any thread.
+    using Producer = std::function<void(Callback)>;
+
+    // Results rejected by `cacheable` are handed to the current waiters but not kept.
+    explicit SingleFlight(std::chrono::milliseconds ttl, std::function<bool(const V&)> cacheable = nullptr,
+                          size_t max_entries = 4096)
+        : ttl_(ttl), cacheable_(std::move(cacheable)), max_entries_(max_entries) {}
+
+    void run(const std::string& key, const Producer& produce, Callback done)
+    {
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto now = std::chrono::steady_clock::now();
+            auto it = entries_.find(key);
+            if (it != entries_.end() && !it->second.done) {
+                it->second.waiters.push_back(std::move(done));
+                coalesced_++;
+                return;
+            }
+            if (it != entries_.end() && it->second.expires_at > now) {
+                V value = it->second.value;
+                coalesced_++;
+                lock.unlock();
+                done(value);
+                return;
+            }
+            if (entries_.size() >= max_entries_) sweep(now);
+            Entry& entry = entries_[key];
+            entry = Entry{};
+            entry.generation = generation = ++next_generation_;
+            entry.waiters.push_back(std::move(done));
+        }
+
+        executions_++;
+        produce([this, key, generation](const V& value) { finish(key, generation, value); });
+    }
+
+    // Drops a finished result so the next caller recomputes it. An execution
+    // already in flight keeps its waiters.
+    void invalidate(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.done) entries_.erase(it);
+    }
+
+    uint64_t executions() const { return executions_.load(); }
+    uint64_t coalesced() const { return coalesced_.load(); }
+
+private:
+    struct Entry
+    {
+        bool done = false;
+        V value;
+        std::vector<Callback> waiters;
+        std::chrono::steady_clock::time_point expires_at;
+        uint64_t generation = 0;
+    };
+
+    void finish(const std::string& key, uint64_t generation, const V& value)
+    {
+        std::vector<Callback> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end() || it->second.generation != generation) return;
+            waiters.swap(it->second.waiters);
+            if (ttl_.count() == 0 || (cacheable_ && !cacheable_(value))) {
+                entries_.erase(it);
+            } else {
+                it->second.done = true;
+                it->second.value = value;
+                it->second.expires_at = std::chrono::steady_clock::now() + ttl_;
+            }
+        }
+        for (auto& waiter : waiters) waiter(value);
+    }
+
+    void sweep(std::chrono::steady_clock::time_point now)
+    {
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.done && it->second.expires_at <= now) it = entries_.erase(it);
+            else ++it;
+        }
+    }
+
+    std::chrono::milliseconds ttl_;
+    std::function<bool(const V&)> cacheable_;
+    size_t max_entries_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    uint64_t next_generation_ = 0;
+    std::atomic<uint64_t> executions_{0};
+    std::atomic<uint64_t> coalesced_{0};
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+// Times every statement run on a watched connection (the DB threads', the
+// inventory shards' and the startup one). Statements slower than the
+// threshold are handed to a background thread, which appends them to the
+// slow-query log as JSON lines: the SQL, the SQL with its bound values, how
+// many rows full table scans stepped through and the EXPLAIN QUERY PLAN. The
+// plan is captured once per distinct SQL, on a read-only connection the log
+// thread opens, so nothing but a queue push happens on the thread that ran the
+// query. Sampled requests also get an "sql" span per statement (tracing.hpp).
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <sqlite3.h>
+#include "include/json.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "tracing.hpp"
+
+struct SlowQuery
+{
+    std::chrono::system_clock::time_point when;
+    int64_t duration_us = 0;
+    std::string sql;          // as prepared, with ? placeholders
+    std::string expanded_sql; // with the bound values filled in
+    int full_scan_steps = 0;
+    int vm_steps = 0;
+    int sorts = 0;
+    int auto_indexes = 0;
+    uint64_t trace_id = 0;
+};
+
+class SlowQueryLog
+{
+public:
+    static constexpr size_t MAX_QUEUED = 1024;
+
+    ~SlowQueryLog() { stop(); }
+
+    // Starts the log thread. A negative threshold disables logging.
+    void start(const std::string& log_path, const std::string& db_path, std::chrono::milliseconds threshold)
+    {
+        if (threshold.count() < 0) return;
+        log_path_ = log_path;
+        db_path_ = db_path;
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+        threshold_us_.store(std::chrono::duration_cast<std::chrono::microseconds>(threshold).count());
+    }
+
+    // Writes out what is queued and stops the thread.
+    void stop()
+    {
+        threshold_us_.store(-1);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    int64_t threshold_us() const { return threshold_us_.load(std::memory_order_relaxed); }
+
+    // Any thread. Never blocks on I/O; drops the entry if the log has fallen behind.
+    void submit(SlowQuery query)
+    {
+        static Counter& logged = metrics().counter("slow_queries_total", "Statements slower than the slow-query threshold");
+        static Counter& dropped = metrics().counter("slow_queries_dropped_total", "Slow statements not logged because the log queue was full");
+        logged.inc();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= MAX_QUEUED) {
+                dropped.inc();
+                return;
+            }
+            queue_.push_back(std::move(query));
+        }
+        wake_.notify_one();
+    }
+
+private:
+    void run()
+    {
+        FILE* out = std::fopen(log_path_.c_str(), "a");
+        if (!out) log_error("can't open slow-query log", {{"path", log_path_}});
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_ || !queue_.empty()) {
+            if (queue_.empty()) {
+                wake_.wait(lock);
+                continue;
+            }
+            std::deque<SlowQuery> batch;
+            batch.swap(queue_);
+            lock.unlock();
+            for (const auto& query : batch) {
+                std::string line = format(query) + "\n";
+                if (out) std::fwrite(line.data(), 1, line.size(), out);
+            }
+            if (out) std::fflush(out);
+            lock.lock();
+        }
+        if (out) std::fclose(out);
+    }
+
+    std::string format(const SlowQuery& query)
+    {
+        char when[40];
+        std::time_t seconds = std::chrono::system_clock::to_time_t(query.when);
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(query.when.time_since_epoch()).count() % 1000;
+        std::tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        size_t n = std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(when + n, sizeof(when) - n, ".%03dZ", static_cast<int>(millis));
+
+        nlohmann::json j;
+        j["time"] = when;
+        j["duration_ms"] = query.duration_us / 1000.0;
+        j["sql"] = query.sql;
+        j["sql_with_params"] = query.expanded_sql;
+        j["full_scan_steps"] = query.full_scan_steps;
+        j["vm_steps"] = query.vm_steps;
+        j["sorts"] = query.sorts;
+        j["auto_indexes"] = query.auto_indexes;
+        if (query.trace_id) j["trace_id"] = query.trace_id;
+        if (explained_.insert(query.sql).second) j["plan"] = query_plan(query.sql);
+        return j.dump();
+    }
+
+    // EXPLAIN QUERY PLAN rows, indented under their parents. A fresh
+    // connection each time, so the plan reflects indexes created since startup.
+    nlohmann::json query_plan(const std::string& sql)
+    {
+        nlohmann::json lines = nlohmann::json::array();
+        sqlite3* db;
+        if (sqlite3_open_v2(db_path_.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(db);
+            return lines;
+        }
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, ("EXPLAIN QUERY PLAN " + sql).c_str(), -1, &stmt, 0) != SQLITE_OK) {
+            sqlite3_close(db);
+            return lines;
+        }
+        std::map<int, int> depth;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int id = sqlite3_column_int(stmt, 0);
+            int parent = sqlite3_column_int(stmt, 1);
+            depth[id] = depth.count(parent) ? depth[parent] + 1 : 0;
+            const unsigned char* detail = sqlite3_column_text(stmt, 3);
+            lines.push_back(std::string(depth[id] * 2, ' ') + (detail ? reinterpret_cast<const char*>(detail) : ""));
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return lines;
+    }
+
+    std::atomic<int64_t> threshold_us_{-1};
+    std::string log_path_;
+    std::string db_path_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<SlowQuery> queue_;
+    bool running_ = false;
+    std::thread thread_;
+    std::unordered_set<std::string> explained_; // log thread only
+};
+
+inline SlowQueryLog& slow_query_log()
+{
+    static SlowQueryLog log;
+    return log;
+}
+
+// Times every statement `db` runs, from its first step until it is reset or
+// finalized. SQLite's own profile time only has millisecond resolution, so
+// the start is taken from our clock when the statement begins.
+inline void watch_statements(sqlite3* db)
+{
+    sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, [](unsigned type, void*, void* p, void*) -> int {
+        // Statements running on this thread; only a handful at a time.
+        thread_local std::vector<std::pair<void*, int64_t>> running;
+        if (type == SQLITE_TRACE_STMT) {
+            for (const auto& r : running) {
+                if (r.first == p) return 0; // a trigger's sub-statement
+            }
+            running.emplace_back(p, Tracer::now_us());
+            return 0;
+        }
+
+        auto it = running.begin();
+        while (it != running.end() && it->first != p) ++it;
+        if (it == running.end()) return 0;
+        int64_t started = it->second;
+        running.erase(it);
+        int64_t ended = Tracer::now_us();
+
+        static Histogram& statement_seconds = metrics().histogram("sql_statement_seconds", "Time from a statement's first step to its reset");
+        statement_seconds.observe((ended - started) / 1e6);
+
+        auto stmt = static_cast<sqlite3_stmt*>(p);
+        // Read with reset so the counters cover this execution only.
+        int full_scan_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+        int vm_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+        int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+        int auto_indexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+
+        const char* sql = sqlite3_sql(stmt);
+        if (current_trace()) trace_record("sql", "sqlite", started, ended, sql ? sql : "");
+
+        int64_t threshold = slow_query_log().threshold_us();
+        if (threshold < 0 || ended - started < threshold) return 0;
+        SlowQuery query;
+        query.when = std::chrono::system_clock::now();
+        query.duration_us = ended - started;
+        query.sql = sql ? sql : "";
+        if (char* expanded = sqlite3_expanded_sql(stmt)) {
+            query.expanded_sql = expanded;
+            sqlite3_free(expanded);
+        }
+        query.full_scan_steps = full_scan_steps;
+        query.vm_steps = vm_steps;
+        query.sorts = sorts;
+        query.auto_indexes = auto_indexes;
+        query.trace_id = current_trace();
+        slow_query_log().submit(std::move(query));
+        return 0;
+    }, nullptr);
+}
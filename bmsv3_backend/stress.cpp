@@ -0,0 +1,490 @@
+// Seat-contention stress harness for /book-tickets.
+//
+// Many concurrent clients book overlapping seats of the same showtimes against
+// a running server. Some of them retry with the same Idempotency-Key, some hang
+// up before reading the answer, and some cancel what they booked so the seats
+// keep changing hands. Afterwards it checks that the server's in-memory seat
+// maps, the BookingSeats rows and the Showtimes seat counters agree, and
+// reports throughput, conflict rate and latencies.
+//
+// Build (from bmsv3_backend):
+//     g++ -std=c++17 -O2 stress.cpp -o stress -I include -lsqlite3 -lpthread
+// Run against a server on its own, freshly created database:
+//     rm -f stress.db* && ./server --port 18181 --db stress.db &
+//     ./stress --port 18181 --db stress.db --clients 64 --requests 200
+// Exits with 1 if any seat ended up double booked or the three records disagree.
+
+#define ASIO_STANDALONE
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+#include <asio.hpp>
+#include "include/json.hpp"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct StressOptions
+{
+    std::string host = "127.0.0.1";
+    int port = 18080;
+    std::string db_path = "blockmyseat.db";
+    int clients = 32;
+    int requests = 100;         // booking attempts per client
+    std::vector<int> showtimes = {1, 2};
+    int hot_seats = 48;         // bookings pick from the first N seats of each showtime
+    int max_party = 4;
+    double retry_rate = 0.1;    // send the same keyed request twice
+    double disconnect_rate = 0.05; // hang up without reading the response
+    double cancel_rate = 0.8;   // cancel a confirmed booking right away
+};
+
+// A showtime's auditorium, as far as the checks need it.
+struct SeatGrid
+{
+    int rows = 0;
+    int width = 0; // seats per row
+
+    std::string identifier(int index) const { return std::string(1, static_cast<char>('A' + index / width)) + std::to_string(index % width + 1); }
+};
+
+struct HttpResponse
+{
+    int status = 0; // 0: transport error
+    std::string body;
+};
+
+// One keep-alive connection; reconnects after errors and hang-ups.
+class HttpClient
+{
+public:
+    HttpClient(const std::string& host, int port) : host_(host), port_(std::to_string(port)), socket_(io_) {}
+
+    HttpResponse request(const std::string& method, const std::string& target, const std::string& body,
+                         const std::vector<std::pair<std::string, std::string>>& headers = {}, bool hang_up = false)
+    {
+        HttpResponse response;
+        try {
+            if (!socket_.is_open()) connect();
+            send(method, target, body, headers);
+            if (hang_up) {
+                close();
+                return response;
+            }
+            if (!receive(response)) close();
+        } catch (const std::exception&) {
+            close();
+            response = HttpResponse();
+        }
+        return response;
+    }
+
+private:
+    void connect()
+    {
+        asio::ip::tcp::resolver resolver(io_);
+        asio::connect(socket_, resolver.resolve(host_, port_));
+        socket_.set_option(asio::ip::tcp::no_delay(true));
+#ifndef _WIN32
+        // A server that stops answering fails the request instead of hanging the run.
+        timeval timeout{10, 0};
+        setsockopt(socket_.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+        buffer_.clear();
+    }
+
+    void close()
+    {
+        asio::error_code ignored;
+        socket_.close(ignored);
+        buffer_.clear();
+    }
+
+    void send(const std::string& method, const std::string& target, const std::string& body,
+              const std::vector<std::pair<std::string, std::string>>& headers)
+    {
+        std::string text = method + " " + target + " HTTP/1.1\r\nHost: " + host_ + "\r\n";
+        for (const auto& header : headers) text += header.first + ": " + header.second + "\r\n";
+        if (!body.empty()) text += "Content-Type: application/json\r\n";
+        text += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        asio::write(socket_, asio::buffer(text));
+    }
+
+    bool receive(HttpResponse& response)
+    {
+        size_t header_end;
+        while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) read_more();
+        std::string head = buffer_.substr(0, header_end);
+        buffer_.erase(0, header_end + 4);
+
+        std::istringstream lines(head);
+        std::string version;
+        lines >> version >> response.status;
+        size_t length = 0;
+        bool keep_alive = true;
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::string lower = line;
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (lower.rfind("content-length:", 0) == 0) length = std::stoul(lower.substr(15));
+            else if (lower.rfind("connection:", 0) == 0 && lower.find("close") != std::string::npos) keep_alive = false;
+        }
+        while (buffer_.size() < length) read_more();
+        response.body = buffer_.substr(0, length);
+        buffer_.erase(0, length);
+        return keep_alive;
+    }
+
+    void read_more()
+    {
+        char chunk[8192];
+        size_t n = socket_.read_some(asio::buffer(chunk));
+        buffer_.append(chunk, n);
+    }
+
+    std::string host_;
+    std::string port_;
+    asio::io_context io_;
+    asio::ip::tcp::socket socket_;
+    std::string buffer_;
+};
+
+// What every client saw; merged after the run.
+struct ClientStats
+{
+    std::map<std::string, long> outcomes;
+    std::vector<double> booking_ms;
+    long retry_mismatches = 0;
+};
+
+// Seats the clients were told they own (confirmed and not cancelled). A
+// confirmation for a seat already in here means the server sold it twice.
+// Seats are released here before the cancel is sent, so a racing rebook of a
+// seat being cancelled can't look like a double booking.
+class SeatLedger
+{
+public:
+    // Returns how many of the seats were already owned by another booking.
+    int confirm(int showtime_id, int booking_id, const std::vector<std::string>& seats)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int overlaps = 0;
+        for (const auto& seat : seats) {
+            auto inserted = owners_.emplace(std::make_pair(showtime_id, seat), booking_id);
+            if (!inserted.second && inserted.first->second != booking_id) ++overlaps;
+        }
+        return overlaps;
+    }
+
+    void release(int showtime_id, const std::vector<std::string>& seats)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& seat : seats) owners_.erase(std::make_pair(showtime_id, seat));
+    }
+
+    std::map<std::pair<int, std::string>, int> snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return owners_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::pair<int, std::string>, int> owners_;
+};
+
+bool parse_options(int argc, char* argv[], StressOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--host") options.host = value;
+            else if (arg == "--port") options.port = std::stoi(value);
+            else if (arg == "--db") options.db_path = value;
+            else if (arg == "--clients") options.clients = std::stoi(value);
+            else if (arg == "--requests") options.requests = std::stoi(value);
+            else if (arg == "--hot-seats") options.hot_seats = std::stoi(value);
+            else if (arg == "--max-party") options.max_party = std::stoi(value);
+            else if (arg == "--retry-rate") options.retry_rate = std::stod(value);
+            else if (arg == "--disconnect-rate") options.disconnect_rate = std::stod(value);
+            else if (arg == "--cancel-rate") options.cancel_rate = std::stod(value);
+            else if (arg == "--showtimes") {
+                options.showtimes.clear();
+                std::stringstream ids(value);
+                std::string id;
+                while (std::getline(ids, id, ',')) options.showtimes.push_back(std::stoi(id));
+            } else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return options.clients > 0 && !options.showtimes.empty() && options.hot_seats > 0 && options.max_party > 0;
+}
+
+// The first `count` seat identifiers of the showtime's auditorium, row by row
+// ("A1", "A2", ...), from the layout the server reports.
+bool hot_seats_for(sqlite3* db, HttpClient& http, int showtime_id, int count, std::vector<std::string>& seats, SeatGrid& grid)
+{
+    sqlite3_stmt* stmt;
+    int auditorium_id = 0;
+    // Same fallback as the server: seeded showtimes without one use auditorium 1.
+    if (sqlite3_prepare_v2(db, "SELECT COALESCE(AuditoriumID, 1) FROM Showtimes WHERE ShowtimeID = ?", -1, &stmt, 0) != SQLITE_OK) return false;
+    sqlite3_bind_int(stmt, 1, showtime_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) auditorium_id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (!auditorium_id) return false;
+
+    HttpResponse details = http.request("GET", "/auditorium-details/" + std::to_string(auditorium_id), "");
+    auto j = json::parse(details.body, nullptr, false);
+    if (details.status != 200 || j.is_discarded()) return false;
+    int rows = j["layout"]["total_rows"];
+    int width = 0;
+    for (int section : j["layout"]["sections"]) width += section;
+    grid = {rows, width};
+    for (int row = 0; row < rows && static_cast<int>(seats.size()) < count; ++row) {
+        for (int n = 1; n <= width && static_cast<int>(seats.size()) < count; ++n) {
+            seats.push_back(std::string(1, static_cast<char>('A' + row)) + std::to_string(n));
+        }
+    }
+    return true;
+}
+
+void run_client(int client, const StressOptions& options, const std::string& run_id,
+                const std::map<int, std::vector<std::string>>& hot_seats, SeatLedger& ledger, ClientStats& stats)
+{
+    HttpClient http(options.host, options.port);
+    std::mt19937 rng(std::random_device{}() + client);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    // Every client is its own user.
+    std::string username = "stress_" + run_id + "_" + std::to_string(client);
+    json account{{"username", username}, {"email", username + "@example.com"}, {"password", "stress"}};
+    http.request("POST", "/signup", account.dump());
+    HttpResponse login = http.request("POST", "/login", json{{"username", username}, {"password", "stress"}}.dump());
+    auto session = json::parse(login.body, nullptr, false);
+    if (login.status != 200 || session.is_discarded()) {
+        ++stats.outcomes["login_failed"];
+        return;
+    }
+    int user_id = session["userId"];
+    std::string auth = "Bearer " + session["token"].get<std::string>();
+
+    for (int i = 0; i < options.requests; ++i) {
+        int showtime_id = options.showtimes[rng() % options.showtimes.size()];
+        const auto& pool = hot_seats.at(showtime_id);
+        std::vector<std::string> seats;
+        int party = 1 + static_cast<int>(rng() % options.max_party);
+        std::sample(pool.begin(), pool.end(), std::back_inserter(seats), std::min<size_t>(party, pool.size()), rng);
+        std::string body = json{{"showtime_id", showtime_id}, {"user_id", user_id}, {"seats", seats}}.dump();
+
+        std::vector<std::pair<std::string, std::string>> headers;
+        bool retry = chance(rng) < options.retry_rate;
+        if (retry) headers.push_back({"Idempotency-Key", username + "-" + std::to_string(i)});
+        if (chance(rng) < options.disconnect_rate) {
+            http.request("POST", "/book-tickets", body, headers, true);
+            ++stats.outcomes["disconnected"];
+            continue;
+        }
+
+        auto started = Clock::now();
+        HttpResponse response = http.request("POST", "/book-tickets", body, headers);
+        stats.booking_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - started).count());
+        if (retry && response.status != 0) {
+            // A client that timed out sends the same request again: a booking
+            // must come back as the same booking, not a second one or a
+            // conflict. Only bookings are remembered, so a retry after a
+            // conflict is a fresh attempt and may get the seats.
+            HttpResponse again = http.request("POST", "/book-tickets", body, headers);
+            if (response.status == 200 && (again.status != response.status || again.body != response.body)) ++stats.retry_mismatches;
+            if (response.status != 200 && again.status == 200) response = again;
+        }
+
+        switch (response.status) {
+        case 200: ++stats.outcomes["booked"]; break;
+        case 409: ++stats.outcomes["conflict"]; continue;
+        case 0: ++stats.outcomes["transport_error"]; continue;
+        default: ++stats.outcomes["http_" + std::to_string(response.status)]; continue;
+        }
+
+        auto confirmed = json::parse(response.body, nullptr, false);
+        int booking_id = confirmed.is_discarded() ? 0 : confirmed.value("booking_id", 0);
+        int overlaps = ledger.confirm(showtime_id, booking_id, seats);
+        if (overlaps) {
+            stats.outcomes["double_booked_seats"] += overlaps;
+            continue;
+        }
+        if (booking_id && chance(rng) < options.cancel_rate) {
+            ledger.release(showtime_id, seats);
+            HttpResponse cancelled = http.request("POST", "/bookings/" + std::to_string(booking_id) + "/cancel", "", {{"Authorization", auth}});
+            if (cancelled.status == 200) ++stats.outcomes["cancelled"];
+            else {
+                ++stats.outcomes["cancel_failed"];
+                ledger.confirm(showtime_id, booking_id, seats);
+            }
+        }
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[])
+{
+    StressOptions options;
+    if (!parse_options(argc, argv, options)) return 2;
+
+    sqlite3* db;
+    if (sqlite3_open_v2(options.db_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "Can't open database " << options.db_path << ": " << sqlite3_errmsg(db) << std::endl;
+        return 2;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    std::map<int, std::vector<std::string>> hot_seats;
+    std::map<int, SeatGrid> grids;
+    {
+        HttpClient http(options.host, options.port);
+        for (int showtime_id : options.showtimes) {
+            if (!hot_seats_for(db, http, showtime_id, options.hot_seats, hot_seats[showtime_id], grids[showtime_id])) {
+                std::cerr << "Showtime " << showtime_id << " not found (is the server running on port " << options.port << " with --db " << options.db_path << "?)" << std::endl;
+                return 2;
+            }
+        }
+    }
+
+    std::string run_id = std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 1000000007);
+    SeatLedger ledger;
+    std::vector<ClientStats> stats(options.clients);
+    std::vector<std::thread> clients;
+    auto started = Clock::now();
+    for (int i = 0; i < options.clients; ++i) {
+        clients.emplace_back([&, i] { run_client(i, options, run_id, hot_seats, ledger, stats[i]); });
+    }
+    for (auto& t : clients) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    ClientStats total;
+    for (auto& s : stats) {
+        for (const auto& outcome : s.outcomes) total.outcomes[outcome.first] += outcome.second;
+        total.booking_ms.insert(total.booking_ms.end(), s.booking_ms.begin(), s.booking_ms.end());
+        total.retry_mismatches += s.retry_mismatches;
+    }
+    std::sort(total.booking_ms.begin(), total.booking_ms.end());
+
+    // The server's three records of each showtime must agree: the seats its
+    // shard has booked in memory (/occupied-seats; the harness takes no
+    // holds), the BookingSeats rows, and the SeatsRemaining counter. A seat
+    // sold twice shows up as a lost row or a counter that is off. Bookings
+    // from clients that hung up may still be committing, so a difference
+    // only counts once it has lasted a second.
+    long seat_map_mismatches = 0, counter_mismatches = 0;
+    {
+        HttpClient http(options.host, options.port);
+        for (int attempt = 0; attempt < 10; ++attempt) {
+            if (attempt) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            seat_map_mismatches = counter_mismatches = 0;
+            for (const auto& entry : grids) {
+                int showtime_id = entry.first;
+                const SeatGrid& grid = entry.second;
+                std::vector<std::string> in_memory, in_table;
+                auto occupied = json::parse(http.request("GET", "/occupied-seats?showtime_id=" + std::to_string(showtime_id), "").body, nullptr, false);
+                if (occupied.is_array()) in_memory = occupied.get<std::vector<std::string>>();
+
+                sqlite3_stmt* stmt;
+                sqlite3_prepare_v2(db, "SELECT SeatIndex FROM BookingSeats WHERE ShowtimeID = ?", -1, &stmt, 0);
+                sqlite3_bind_int(stmt, 1, showtime_id);
+                while (sqlite3_step(stmt) == SQLITE_ROW) in_table.push_back(grid.identifier(sqlite3_column_int(stmt, 0)));
+                sqlite3_finalize(stmt);
+
+                std::sort(in_memory.begin(), in_memory.end());
+                std::sort(in_table.begin(), in_table.end());
+                std::vector<std::string> differ;
+                std::set_symmetric_difference(in_memory.begin(), in_memory.end(), in_table.begin(), in_table.end(), std::back_inserter(differ));
+                seat_map_mismatches += static_cast<long>(differ.size());
+
+                sqlite3_prepare_v2(db, "SELECT SeatsRemaining FROM Showtimes WHERE ShowtimeID = ?", -1, &stmt, 0);
+                sqlite3_bind_int(stmt, 1, showtime_id);
+                int remaining = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+                sqlite3_finalize(stmt);
+                bool counter_off = remaining != grid.rows * grid.width - static_cast<int>(in_table.size());
+                if (counter_off) ++counter_mismatches;
+                if (attempt == 9) {
+                    for (const auto& seat : differ) std::cout << "SEAT MAP MISMATCH showtime " << showtime_id << " seat " << seat << "\n";
+                    if (counter_off) std::cout << "COUNTER MISMATCH showtime " << showtime_id << " SeatsRemaining " << remaining << "\n";
+                }
+            }
+            if (!seat_map_mismatches && !counter_mismatches) break;
+        }
+    }
+
+    // Every seat a client still owns must be booked under that client's booking.
+    sqlite3_stmt* stmt;
+    long missing_seats = 0;
+    sqlite3_prepare_v2(db, "SELECT OrderID FROM BookingSeats WHERE ShowtimeID = ? AND SeatIndex = ?", -1, &stmt, 0);
+    for (const auto& owned : ledger.snapshot()) {
+        // Hot seats are listed row by row from the first seat, so a seat's
+        // position in the list is its SeatIndex.
+        const auto& pool = hot_seats.at(owned.first.first);
+        int index = static_cast<int>(std::find(pool.begin(), pool.end(), owned.first.second) - pool.begin());
+        sqlite3_bind_int(stmt, 1, owned.first.first);
+        sqlite3_bind_int(stmt, 2, index);
+        if (sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_int(stmt, 0) != owned.second) ++missing_seats;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    long answered = 0;
+    for (const auto& outcome : total.outcomes) {
+        if (outcome.first != "disconnected" && outcome.first != "transport_error" && outcome.first != "cancelled" &&
+            outcome.first != "cancel_failed" && outcome.first != "double_booked_seats" && outcome.first != "login_failed")
+            answered += outcome.second;
+    }
+    long attempts = static_cast<long>(total.booking_ms.size()) + total.outcomes["disconnected"];
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "clients " << options.clients << ", showtimes " << options.showtimes.size()
+              << ", hot seats " << options.hot_seats << " each, " << seconds << " s\n";
+    std::cout << "booking attempts " << attempts << " (" << attempts / seconds << "/s)\n";
+    for (const auto& outcome : total.outcomes) std::cout << "  " << outcome.first << " " << outcome.second << "\n";
+    std::cout << "conflict rate " << (answered ? 100.0 * total.outcomes["conflict"] / answered : 0.0) << "%\n";
+    std::cout << "latency ms p50 " << percentile(total.booking_ms, 0.50) << " p90 " << percentile(total.booking_ms, 0.90)
+              << " p99 " << percentile(total.booking_ms, 0.99) << " p99.9 " << percentile(total.booking_ms, 0.999)
+              << " max " << (total.booking_ms.empty() ? 0.0 : total.booking_ms.back()) << "\n";
+    std::cout << "retries answered differently " << total.retry_mismatches << "\n";
+    std::cout << "confirmed seats missing from BookingSeats " << missing_seats << "\n";
+    std::cout << "seats where memory and BookingSeats disagree " << seat_map_mismatches << "\n";
+    std::cout << "showtimes with SeatsRemaining off " << counter_mismatches << "\n";
+
+    bool ok = seat_map_mismatches == 0 && counter_mismatches == 0 && total.outcomes["double_booked_seats"] == 0 && missing_seats == 0;
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+// Supervisor mode (POSIX only). The supervisor process serves nothing itself:
+// it starts `workers` copies of the server, which all listen on the same port
+// through SO_REUSEPORT, and restarts any that die.
+//
+// SIGHUP replaces the workers without refusing a connection. A new generation
+// is started and each worker reports ready (listening) over a pipe; only then
+// are the old ones sent SIGTERM, on which they stop accepting and drain.
+// Workers are exec'd rather than just forked, so a SIGHUP after the binary was
+// replaced on disk starts the new build. SIGTERM/SIGINT drain everything and exit.
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Signals a worker handles itself (by draining) rather than dying on.
+inline sigset_t shutdown_signals()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    return set;
+}
+
+// Must run before any thread starts so every thread inherits the mask and the
+// signals can only be picked up with sigwait().
+inline void block_shutdown_signals()
+{
+    sigset_t set = shutdown_signals();
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+// Worker side of the readiness pipe: called once the server is listening.
+inline void notify_ready(int ready_fd)
+{
+    if (ready_fd < 0) return;
+    ssize_t written = write(ready_fd, "R", 1);
+    (void)written;
+    close(ready_fd);
+}
+
+// Path to re-exec for new workers. /proc/self/exe would keep pointing at the
+// old (replaced) file, so resolve argv[0] instead.
+inline std::string executable_path(const char* argv0)
+{
+    char resolved[PATH_MAX];
+    if (std::strchr(argv0, '/') && realpath(argv0, resolved)) return resolved;
+    ssize_t n = readlink("/proc/self/exe", resolved, sizeof(resolved) - 1);
+    if (n > 0) {
+        resolved[n] = '\0';
+        return resolved;
+    }
+    return argv0;
+}
+
+class Supervisor
+{
+public:
+    // `worker_args` is the argv each worker gets (argv[0] included);
+    // "--ready-fd <fd>" is appended to it.
+    Supervisor(std::string exe, std::vector<std::string> worker_args, int workers)
+        : exe_(std::move(exe)), worker_args_(std::move(worker_args)), worker_count_(workers) {}
+
+    int run()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        for (int sig : {SIGHUP, SIGTERM, SIGINT, SIGCHLD}) sigaddset(&signals, sig);
+        sigprocmask(SIG_BLOCK, &signals, &original_mask_);
+
+        std::cout << "Supervisor " << getpid() << " starting " << worker_count_ << " workers..." << std::endl;
+        if (!start_generation()) {
+            std::cerr << "Supervisor: workers failed to start." << std::endl;
+            stop_all();
+            return 1;
+        }
+        std::cout << "Supervisor ready. SIGHUP restarts the workers, SIGTERM stops everything." << std::endl;
+
+        while (true) {
+            timespec tick{1, 0};
+            int sig = sigtimedwait(&signals, nullptr, &tick);
+            if (sig == SIGTERM || sig == SIGINT) {
+                std::cout << "Supervisor: shutting down." << std::endl;
+                stop_all();
+                return 0;
+            }
+            if (sig == SIGHUP) reload();
+            reap();
+            replace_missing();
+        }
+    }
+
+private:
+    struct Worker
+    {
+        pid_t pid;
+        int generation;
+    };
+
+    static constexpr int READY_TIMEOUT_MS = 60000;
+
+    // Starts one worker and waits until it is listening; -1 on failure.
+    pid_t spawn()
+    {
+        int fds[2];
+        if (pipe(fds) != 0) return -1;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return -1;
+        }
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &original_mask_, nullptr);
+            std::vector<std::string> args = worker_args_;
+            args.push_back("--ready-fd");
+            args.push_back(std::to_string(fds[1]));
+            std::vector<char*> argv;
+            for (auto& arg : args) argv.push_back(&arg[0]);
+            argv.push_back(nullptr);
+            execv(exe_.c_str(), argv.data());
+            std::cerr << "Supervisor: exec " << exe_ << " failed: " << std::strerror(errno) << std::endl;
+            _exit(127);
+        }
+
+        close(fds[1]);
+        pollfd pfd{fds[0], POLLIN, 0};
+        char byte = 0;
+        bool ready = poll(&pfd, 1, READY_TIMEOUT_MS) == 1 && read(fds[0], &byte, 1) == 1;
+        close(fds[0]);
+        if (!ready) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            return -1;
+        }
+        return pid;
+    }
+
+    // Workers start one at a time, so only one of them runs the schema
+    // setup and seeding in init_database() at once.
+    bool start_generation()
+    {
+        ++generation_;
+        for (int i = 0; i < worker_count_; ++i) {
+            pid_t pid = spawn();
+            if (pid < 0) {
+                for (size_t j = 0; j < workers_.size();) {
+                    if (workers_[j].generation != generation_) {
+                        ++j;
+                        continue;
+                    }
+                    kill(workers_[j].pid, SIGTERM);
+                    waitpid(workers_[j].pid, nullptr, 0);
+                    workers_.erase(workers_.begin() + j);
+                }
+                --generation_;
+                return false;
+            }
+            workers_.push_back({pid, generation_});
+        }
+        return true;
+    }
+
+    void reload()
+    {
+        std::cout << "Supervisor: starting generation " << generation_ + 1 << "..." << std::endl;
+        int old_generation = generation_;
+        if (!start_generation()) {
+            std::cerr << "Supervisor: new workers failed to start, keeping generation " << old_generation << "." << std::endl;
+            return;
+        }
+        for (const auto& w : workers_) {
+            if (w.generation < generation_) kill(w.pid, SIGTERM);
+        }
+        std::cout << "Supervisor: generation " << generation_ << " is serving, older workers are draining." << std::endl;
+    }
+
+    void reap()
+    {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                if (workers_[i].pid != pid) continue;
+                if (workers_[i].generation == generation_) {
+                    std::cerr << "Supervisor: worker " << pid << " exited unexpectedly (status " << status << ")." << std::endl;
+                }
+                workers_.erase(workers_.begin() + i);
+                break;
+            }
+        }
+    }
+
+    void replace_missing()
+    {
+        int current = 0;
+        for (const auto& w : workers_) current += w.generation == generation_;
+        for (; current < worker_count_; ++current) {
+            pid_t pid = spawn();
+            if (pid < 0) return; // try again on the next tick
+            workers_.push_back({pid, generation_});
+        }
+    }
+
+    void stop_all()
+    {
+        for (const auto& w : workers_) kill(w.pid, SIGTERM);
+        for (const auto& w : workers_) waitpid(w.pid, nullptr, 0);
+        workers_.clear();
+    }
+
+    std::string exe_;
+    std::vector<std::string> worker_args_;
+    int worker_count_;
+    int generation_ = 0;
+    std::vector<Worker> workers_;
+    sigset_t original_mask_;
+};
+
+#endif
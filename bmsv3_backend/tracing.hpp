@@ -0,0 +1,222 @@
+#pragma once
+
+// Sampled per-request tracing. A sampled request gets a trace id that follows
+// it from the I/O thread to the DB and inventory threads (run_on_db, shard
+// posts and writes carry it across), and every TraceSpan opened while it is
+// current records a complete begin/end event in a fixed-size ring buffer owned
+// by that thread. SQL statements are recorded by watch_statements() in
+// slow_query_log.hpp. Requests that aren't sampled only pay a thread-local
+// read per span. /debug/traces renders the recent events of all threads as Chrome
+// trace-event JSON, which chrome://tracing and ui.perfetto.dev open directly.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "include/json.hpp"
+
+struct TraceEvent
+{
+    const char* name = "";     // static strings only
+    const char* category = "";
+    uint64_t trace_id = 0;
+    int64_t start_us = 0;
+    int64_t duration_us = 0;
+    std::string detail;        // e.g. the SQL text or the request line
+};
+
+// One thread's recent events. Written by its thread, read by /debug/traces.
+class TraceBuffer
+{
+public:
+    static constexpr size_t CAPACITY = 4096;
+
+    explicit TraceBuffer(int tid) : tid_(tid) { events_.reserve(CAPACITY); }
+
+    void record(TraceEvent event)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (events_.size() < CAPACITY) events_.push_back(std::move(event));
+        else events_[next_] = std::move(event);
+        next_ = (next_ + 1) % CAPACITY;
+    }
+
+    void name(const std::string& thread_name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (name_.empty()) name_ = thread_name;
+    }
+
+    int tid() const { return tid_; }
+
+    void copy_to(std::vector<TraceEvent>& out, std::string& thread_name) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.insert(out.end(), events_.begin(), events_.end());
+        thread_name = name_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<TraceEvent> events_;
+    size_t next_ = 0;
+    int tid_;
+    std::string name_;
+};
+
+class Tracer
+{
+public:
+    static Tracer& instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // Fraction of requests traced, 0 (default, off) to 1.
+    void set_sample_rate(double rate) { sample_rate_.store(rate < 0 ? 0 : rate > 1 ? 1 : rate); }
+    double sample_rate() const { return sample_rate_.load(); }
+
+    // A new trace id if this request is sampled (or `force`d), else 0.
+    uint64_t start_trace(bool force = false)
+    {
+        double rate = sample_rate_.load(std::memory_order_relaxed);
+        if (!force) {
+            if (rate <= 0) return 0;
+            thread_local std::minstd_rand rng(std::random_device{}());
+            if (rate < 1 && std::uniform_real_distribution<double>(0, 1)(rng) >= rate) return 0;
+        }
+        return next_trace_id_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TraceBuffer& local()
+    {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer = std::make_shared<TraceBuffer>(static_cast<int>(buffers_.size()) + 1);
+            buffers_.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static int64_t now_us() { return to_us(std::chrono::steady_clock::now()); }
+
+    static int64_t to_us(std::chrono::steady_clock::time_point t)
+    {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch).count();
+    }
+
+    // Chrome trace-event JSON ("X" complete events plus thread names) of
+    // everything still in the buffers, or of one trace if trace_id is set.
+    std::string chrome_json(uint64_t trace_id = 0)
+    {
+        std::vector<std::shared_ptr<TraceBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers = buffers_;
+        }
+        nlohmann::json events = nlohmann::json::array();
+        for (const auto& buffer : buffers) {
+            std::vector<TraceEvent> recorded;
+            std::string thread_name;
+            buffer->copy_to(recorded, thread_name);
+            if (recorded.empty()) continue;
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", buffer->tid()},
+                              {"args", {{"name", thread_name.empty() ? "thread" : thread_name}}}});
+            for (const auto& event : recorded) {
+                if (trace_id && event.trace_id != trace_id) continue;
+                nlohmann::json args{{"trace_id", event.trace_id}};
+                if (!event.detail.empty()) args["detail"] = event.detail;
+                events.push_back({{"name", event.name}, {"cat", event.category}, {"ph", "X"},
+                                  {"ts", event.start_us}, {"dur", event.duration_us},
+                                  {"pid", 1}, {"tid", buffer->tid()}, {"args", args}});
+            }
+        }
+        return nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+    }
+
+private:
+    std::atomic<double> sample_rate_{0};
+    std::atomic<uint64_t> next_trace_id_{1};
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+};
+
+// The trace the current thread is working for; 0 when not sampled.
+inline uint64_t& current_trace()
+{
+    thread_local uint64_t trace_id = 0;
+    return trace_id;
+}
+
+// Makes `trace_id` current for a scope, e.g. a job picked up on a DB thread.
+class TraceScope
+{
+public:
+    explicit TraceScope(uint64_t trace_id) : previous_(current_trace()) { current_trace() = trace_id; }
+    ~TraceScope() { current_trace() = previous_; }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint64_t previous_;
+};
+
+inline void trace_record(uint64_t trace_id, const char* name, const char* category, int64_t start_us, int64_t end_us, std::string detail = "")
+{
+    if (!trace_id) return;
+    TraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.trace_id = trace_id;
+    event.start_us = start_us;
+    event.duration_us = end_us - start_us;
+    event.detail = std::move(detail);
+    Tracer::instance().local().record(std::move(event));
+}
+
+// Records an event for the current trace, if any.
+inline void trace_record(const char* name, const char* category, int64_t start_us, int64_t end_us, std::string detail = "")
+{
+    trace_record(current_trace(), name, category, start_us, end_us, std::move(detail));
+}
+
+inline void trace_thread_name(const std::string& name)
+{
+    if (current_trace()) Tracer::instance().local().name(name);
+}
+
+// Records [construction, destruction) as one event of the trace that was
+// current at construction, if any.
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name, const char* category = "app")
+        : name_(name), category_(category), trace_id_(current_trace()), start_us_(trace_id_ ? Tracer::now_us() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (trace_id_) trace_record(trace_id_, name_, category_, start_us_, Tracer::now_us(), std::move(detail_));
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void set_detail(std::string detail)
+    {
+        if (trace_id_) detail_ = std::move(detail);
+    }
+
+private:
+    const char* name_;
+    const char* category_;
+    uint64_t trace_id_;
+    int64_t start_us_;
+    std::string detail_;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+// "Trending now": the movies and showtimes selling the most tickets over the
+// last hour and the last day, estimated from the stream of booking commits
+// instead of grouping the bookings tables. Each window is a ring of count-min
+// sketches, one per slice of it (5 minutes of the hour, an hour of the day);
+// a slice's sketch is cleared when the ring comes round to it again, and a
+// key's count over the window is the count-min estimate over the slices
+// added together. Next to the sketches sits a bounded set of candidates, the
+// heaviest keys seen so far ordered by estimate, so the top K are read off
+// its front. Estimates only ever overcount, by at most 2/width of the tickets
+// in the window with probability 1 - 2^-depth.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "metrics.hpp"
+
+class CountMinSketch
+{
+public:
+    static constexpr size_t DEPTH = 4;
+    static constexpr size_t WIDTH = 1024; // a power of two
+
+    CountMinSketch() : cells_(DEPTH * WIDTH, 0) {}
+
+    void add(int key, uint32_t n)
+    {
+        for (size_t row = 0; row < DEPTH; ++row) cells_[row * WIDTH + column(row, key)] += n;
+    }
+
+    uint32_t cell(size_t row, size_t column) const { return cells_[row * WIDTH + column]; }
+    void clear() { std::fill(cells_.begin(), cells_.end(), 0); }
+
+    // splitmix64 of the key under a different seed per row.
+    static size_t column(size_t row, int key)
+    {
+        uint64_t x = static_cast<uint32_t>(key) + (row + 1) * 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<size_t>(x ^ (x >> 31)) & (WIDTH - 1);
+    }
+
+private:
+    std::vector<uint32_t> cells_;
+};
+
+// Heavy hitters over a sliding window of `slices` x `slice`. Not thread-safe.
+class WindowedTopK
+{
+public:
+    struct Entry
+    {
+        int key;
+        uint64_t count;
+        int tag; // whatever the caller recorded with the key (a showtime's movie)
+    };
+
+    WindowedTopK(std::chrono::seconds slice, size_t slices, size_t candidates)
+        : slice_(slice), ring_(slices), max_candidates_(candidates) {}
+
+    void add(int key, uint32_t n, int tag, std::chrono::steady_clock::time_point now)
+    {
+        advance(now);
+        ring_[current_ % ring_.size()].sketch.add(key, n);
+        uint64_t count = estimate(key);
+
+        auto it = candidates_.find(key);
+        if (it != candidates_.end()) {
+            order_.erase({it->second.count, key});
+            it->second = {count, tag};
+            order_.insert({count, key});
+            return;
+        }
+        if (candidates_.size() >= max_candidates_) {
+            auto lightest = order_.begin();
+            if (lightest->first >= count) return;
+            candidates_.erase(lightest->second);
+            order_.erase(lightest);
+        }
+        candidates_[key] = {count, tag};
+        order_.insert({count, key});
+    }
+
+    // The k heaviest keys, heaviest first.
+    std::vector<Entry> top(size_t k, std::chrono::steady_clock::time_point now)
+    {
+        advance(now);
+        std::vector<Entry> out;
+        for (auto it = order_.rbegin(); it != order_.rend() && out.size() < k; ++it) {
+            out.push_back({it->second, it->first, candidates_.at(it->second).tag});
+        }
+        return out;
+    }
+
+    // Count-min over the sum of the live slices.
+    uint64_t estimate(int key) const
+    {
+        uint64_t best = UINT64_MAX;
+        for (size_t row = 0; row < CountMinSketch::DEPTH; ++row) {
+            size_t column = CountMinSketch::column(row, key);
+            uint64_t sum = 0;
+            for (const auto& slice : ring_) {
+                if (slice.epoch >= 0) sum += slice.sketch.cell(row, column);
+            }
+            best = std::min(best, sum);
+        }
+        return best;
+    }
+
+private:
+    struct Slice
+    {
+        int64_t epoch = -1; // which slice of time it holds; -1 empty
+        CountMinSketch sketch;
+    };
+
+    // Moves the ring on to the slice `now` falls in, reusing the ones that
+    // have dropped out of the window, and re-counts the candidates when the
+    // window has moved.
+    void advance(std::chrono::steady_clock::time_point now)
+    {
+        int64_t epoch = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count() / slice_.count();
+        if (epoch == current_) return;
+        int64_t slices = static_cast<int64_t>(ring_.size());
+        for (int64_t e = std::max(current_ + 1, epoch - slices + 1); e <= epoch; ++e) {
+            Slice& slice = ring_[e % slices];
+            slice.sketch.clear();
+            slice.epoch = e;
+        }
+        current_ = epoch;
+
+        order_.clear();
+        for (auto it = candidates_.begin(); it != candidates_.end();) {
+            it->second.count = estimate(it->first);
+            if (it->second.count == 0) {
+                it = candidates_.erase(it);
+                continue;
+            }
+            order_.insert({it->second.count, it->first});
+            ++it;
+        }
+    }
+
+    struct Candidate
+    {
+        uint64_t count;
+        int tag;
+    };
+
+    std::chrono::seconds slice_;
+    std::vector<Slice> ring_;
+    int64_t current_ = -1;
+    size_t max_candidates_;
+    std::unordered_map<int, Candidate> candidates_;
+    std::set<std::pair<uint64_t, int>> order_; // (count, key), lightest first
+};
+
+enum class TrendingWindow { Hour, Day };
+
+// Tickets booked per movie and per showtime, over the last hour and day.
+// Fed from booking commits on the inventory shards; any thread.
+class TrendingTracker
+{
+public:
+    static constexpr size_t CANDIDATES = 256;
+
+    TrendingTracker()
+        : movies_hour_(std::chrono::minutes(5), 12, CANDIDATES), movies_day_(std::chrono::hours(1), 24, CANDIDATES),
+          showtimes_hour_(std::chrono::minutes(5), 12, CANDIDATES), showtimes_day_(std::chrono::hours(1), 24, CANDIDATES),
+          recorded_(metrics().counter("trending_tickets_total", "Booked tickets fed to the trending sketches"))
+    {
+    }
+
+    void record(int movie_id, int showtime_id, uint32_t tickets)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        movies_hour_.add(movie_id, tickets, 0, now);
+        movies_day_.add(movie_id, tickets, 0, now);
+        showtimes_hour_.add(showtime_id, tickets, movie_id, now);
+        showtimes_day_.add(showtime_id, tickets, movie_id, now);
+        recorded_.inc(tickets);
+    }
+
+    std::vector<WindowedTopK::Entry> top_movies(TrendingWindow window, size_t k)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (window == TrendingWindow::Hour ? movies_hour_ : movies_day_).top(k, std::chrono::steady_clock::now());
+    }
+
+    // Each entry's tag is the showtime's movie.
+    std::vector<WindowedTopK::Entry> top_showtimes(TrendingWindow window, size_t k)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (window == TrendingWindow::Hour ? showtimes_hour_ : showtimes_day_).top(k, std::chrono::steady_clock::now());
+    }
+
+private:
+    std::mutex mutex_;
+    WindowedTopK movies_hour_;
+    WindowedTopK movies_day_;
+    WindowedTopK showtimes_hour_;
+    WindowedTopK showtimes_day_;
+    Counter& recorded_;
+};
+
+// Every `interval`, hands the showtimes trending over the last hour to `keep`
+// on its own thread, so their seat maps can be loaded (or refreshed) ahead of
+// the next rush on them.
+class HotShowtimeKeeper
+{
+public:
+    using Keep = std::function<void(const std::vector<int>& showtime_ids)>;
+
+    ~HotShowtimeKeeper() { stop(); }
+
+    void start(TrendingTracker& tracker, size_t count, std::chrono::milliseconds interval, Keep keep)
+    {
+        tracker_ = &tracker;
+        count_ = count;
+        interval_ = interval;
+        keep_ = std::move(keep);
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+private:
+    void run()
+    {
+        static Gauge& kept = metrics().gauge("trending_hot_showtimes", "Trending showtimes whose seat maps are kept loaded");
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!wake_.wait_for(lock, interval_, [this] { return !running_; })) {
+            lock.unlock();
+            std::vector<int> ids;
+            for (const auto& entry : tracker_->top_showtimes(TrendingWindow::Hour, count_)) ids.push_back(entry.key);
+            kept.set(static_cast<int64_t>(ids.size()));
+            if (!ids.empty()) keep_(ids);
+            lock.lock();
+        }
+    }
+
+    TrendingTracker* tracker_ = nullptr;
+    size_t count_ = 0;
+    std::chrono::milliseconds interval_{1000};
+    Keep keep_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread thread_;
+};
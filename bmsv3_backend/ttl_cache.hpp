@@ -0,0 +1,76 @@
+#pragma once
+
+// Small thread-safe key/value cache whose entries expire after a fixed TTL.
+// When full, the entry closest to expiry is dropped. Meant for values that
+// are expensive to load and cheap to copy (typically shared_ptr<const T>).
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+template <class V>
+class TtlCache
+{
+public:
+    TtlCache(std::chrono::milliseconds ttl, size_t capacity) : ttl_(ttl), capacity_(capacity) {}
+
+    bool get(const std::string& key, V& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return false;
+        if (it->second.expires_at <= std::chrono::steady_clock::now()) {
+            entries_.erase(it);
+            return false;
+        }
+        out = it->second.value;
+        return true;
+    }
+
+    void put(const std::string& key, V value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (entries_.size() >= capacity_ && !entries_.count(key)) evict(now);
+        entries_[key] = {std::move(value), now + ttl_};
+    }
+
+    void erase(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(key);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+private:
+    struct Entry
+    {
+        V value;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    void evict(std::chrono::steady_clock::time_point now)
+    {
+        auto oldest = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.expires_at <= now) {
+                it = entries_.erase(it);
+                continue;
+            }
+            if (oldest == entries_.end() || it->second.expires_at < oldest->second.expires_at) oldest = it;
+            ++it;
+        }
+        if (entries_.size() >= capacity_ && oldest != entries_.end()) entries_.erase(oldest);
+    }
+
+    std::chrono::milliseconds ttl_;
+    size_t capacity_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+// Waitlist for one showtime, kept in join order. Like ShowtimeSeats it is
+// owned by the inventory shard of its showtime and only touched on that
+// shard's thread.
+// When seats come free (a cancellation, an expired hold), match() walks the
+// waiting parties in order and gives each one that now fits a block of
+// adjacent seats as a hold, which the party books with /book-tickets. A party
+// too big for what is free doesn't block smaller parties behind it.
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "seat_map.hpp"
+
+struct WaitlistEntry
+{
+    enum class Status { Waiting, Offered, Booked, Expired, Left };
+
+    std::string id;
+    int user_id = 0;
+    int party_size = 1;
+    SeatClass seat_class = SeatClass::Any;
+    Status status = Status::Waiting;
+    // While Offered: the hold reserving `seats` for this party.
+    std::string hold_id;
+    std::vector<int> seats;
+    std::chrono::steady_clock::time_point offer_expires;
+};
+
+inline const char* waitlist_status_name(WaitlistEntry::Status status)
+{
+    switch (status) {
+    case WaitlistEntry::Status::Waiting: return "waiting";
+    case WaitlistEntry::Status::Offered: return "offered";
+    case WaitlistEntry::Status::Booked: return "booked";
+    case WaitlistEntry::Status::Expired: return "expired";
+    case WaitlistEntry::Status::Left: return "left";
+    }
+    return "unknown";
+}
+
+class ShowtimeWaitlist
+{
+public:
+    static constexpr size_t MAX_FINISHED = 256;
+
+    WaitlistEntry& join(std::string id, int user_id, int party_size, SeatClass seat_class)
+    {
+        WaitlistEntry entry;
+        entry.id = std::move(id);
+        entry.user_id = user_id;
+        entry.party_size = party_size;
+        entry.seat_class = seat_class;
+        active_.push_back(std::move(entry));
+        return active_.back();
+    }
+
+    const WaitlistEntry* find(const std::string& id) const
+    {
+        for (const auto& entry : active_) {
+            if (entry.id == id) return &entry;
+        }
+        for (const auto& entry : finished_) {
+            if (entry.id == id) return &entry;
+        }
+        return nullptr;
+    }
+
+    // 1-based place among the parties still waiting; 0 if not waiting.
+    int position(const std::string& id) const
+    {
+        int place = 0;
+        for (const auto& entry : active_) {
+            if (entry.status != WaitlistEntry::Status::Waiting) continue;
+            ++place;
+            if (entry.id == id) return place;
+        }
+        return 0;
+    }
+
+    size_t waiting() const
+    {
+        size_t n = 0;
+        for (const auto& entry : active_) n += entry.status == WaitlistEntry::Status::Waiting;
+        return n;
+    }
+
+    bool empty() const { return active_.empty(); }
+
+    // Drops the party; an outstanding offer's hold is released. Returns the
+    // seats that became free, for the next parties in line.
+    std::vector<int> leave(const std::string& id, ShowtimeSeats& seats)
+    {
+        std::vector<int> freed;
+        for (size_t i = 0; i < active_.size(); ++i) {
+            if (active_[i].id != id) continue;
+            if (active_[i].status == WaitlistEntry::Status::Offered && seats.find_hold(active_[i].hold_id)) {
+                seats.release_hold(active_[i].hold_id);
+                freed = active_[i].seats;
+            }
+            finish(i, WaitlistEntry::Status::Left);
+            break;
+        }
+        return freed;
+    }
+
+    // Settles offers whose hold is gone (booked, or expired), then offers
+    // blocks to waiting parties in join order. Returns how many new offers
+    // were made; make_hold_id names each new hold.
+    int match(ShowtimeSeats& seats, std::chrono::steady_clock::duration offer_ttl, const std::function<std::string()>& make_hold_id)
+    {
+        settle(seats);
+        int offers = 0;
+        for (auto& entry : active_) {
+            if (entry.status != WaitlistEntry::Status::Waiting) continue;
+            std::vector<int> block = seats.find_best_block(entry.party_size, entry.seat_class, true);
+            if (block.empty()) continue;
+            entry.status = WaitlistEntry::Status::Offered;
+            entry.hold_id = make_hold_id();
+            entry.seats = block;
+            entry.offer_expires = std::chrono::steady_clock::now() + offer_ttl;
+            seats.add_hold(entry.hold_id, block, offer_ttl);
+            ++offers;
+        }
+        return offers;
+    }
+
+    void settle(const ShowtimeSeats& seats)
+    {
+        for (size_t i = 0; i < active_.size();) {
+            const WaitlistEntry& entry = active_[i];
+            if (entry.status != WaitlistEntry::Status::Offered || seats.find_hold(entry.hold_id)) {
+                ++i;
+                continue;
+            }
+            bool booked = true;
+            for (int seat : entry.seats) booked = booked && seats.is_booked(seat);
+            finish(i, booked ? WaitlistEntry::Status::Booked : WaitlistEntry::Status::Expired);
+        }
+    }
+
+private:
+    void finish(size_t index, WaitlistEntry::Status status)
+    {
+        active_[index].status = status;
+        finished_.push_back(std::move(active_[index]));
+        active_.erase(active_.begin() + index);
+        if (finished_.size() > MAX_FINISHED) finished_.pop_front();
+    }
+
+    std::deque<WaitlistEntry> active_;   // Waiting and Offered, in join order
+    std::deque<WaitlistEntry> finished_; // recently settled, for status lookups
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+// Startup warm-up in named stages (the catalog, auditorium layouts, seat
+// state of upcoming showtimes ...) that run side by side on the DB threads
+// and inventory shards while the server comes up. A stage is told how many
+// items it has and ticks them off as they load; once every stage has
+// finished the instance is ready, which /readyz reports to load balancers.
+// Progress and durations are on /metrics: warmup_items_total,
+// warmup_items_done and warmup_stage_seconds per stage, warmup_seconds and
+// server_ready.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "include/json.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+
+class WarmUp
+{
+public:
+    class Stage
+    {
+    public:
+        Stage(WarmUp& owner, std::string name)
+            : owner_(owner), name_(std::move(name)),
+              total_(metrics().gauge("warmup_items_total", "Items each warm-up stage has to load", "stage=\"" + name_ + "\"")),
+              done_(metrics().gauge("warmup_items_done", "Items each warm-up stage has loaded so far", "stage=\"" + name_ + "\""))
+        {
+        }
+
+        // Sets the number of items, once; a stage with none is finished at once.
+        void start(size_t total)
+        {
+            total_.set(static_cast<int64_t>(total));
+            remaining_.store(static_cast<int64_t>(total));
+            if (total == 0) finish();
+        }
+
+        void done(size_t n = 1)
+        {
+            done_.add(static_cast<int64_t>(n));
+            if (remaining_.fetch_sub(static_cast<int64_t>(n)) == static_cast<int64_t>(n)) finish();
+        }
+
+        const std::string& name() const { return name_; }
+        bool finished() const { return finished_.load(); }
+        size_t total() const { return static_cast<size_t>(total_.value()); }
+        size_t completed() const { return static_cast<size_t>(done_.value()); }
+
+        // Time from the start of the warm-up to this stage finishing (or now).
+        double seconds() const
+        {
+            int64_t us = finished_us_.load();
+            return (us >= 0 ? us : owner_.elapsed_us()) / 1e6;
+        }
+
+    private:
+        void finish()
+        {
+            if (finished_.exchange(true)) return;
+            finished_us_.store(owner_.elapsed_us());
+            owner_.stage_finished(*this);
+        }
+
+        WarmUp& owner_;
+        std::string name_;
+        Gauge& total_;
+        Gauge& done_;
+        std::atomic<int64_t> remaining_{0};
+        std::atomic<bool> finished_{false};
+        std::atomic<int64_t> finished_us_{-1};
+    };
+
+    WarmUp()
+    {
+        metrics().gauge_fn("warmup_seconds", "Time the startup warm-up took (so far, until it finishes)", [this] { return elapsed_seconds(); });
+        metrics().gauge_fn("server_ready", "1 once the warm-up has finished, 0 before", [this] { return ready() ? 1.0 : 0.0; });
+    }
+
+    // Starts the clock. Stages are added after this and before seal().
+    void begin() { started_ = std::chrono::steady_clock::now(); }
+
+    std::shared_ptr<Stage> stage(const std::string& name)
+    {
+        auto stage = std::make_shared<Stage>(*this, name);
+        metrics().gauge_fn("warmup_stage_seconds", "Time each warm-up stage took (so far, until it finishes)",
+                           [stage] { return stage->seconds(); }, "stage=\"" + name + "\"");
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages_.push_back(stage);
+        return stage;
+    }
+
+    // Every stage has been added; the warm-up is over once they have finished.
+    void seal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sealed_ = true;
+        }
+        check();
+    }
+
+    bool ready() const { return ready_.load(); }
+
+    // Blocks until ready().
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_cv_.wait(lock, [this] { return ready_.load(); });
+    }
+
+    double elapsed_seconds() const
+    {
+        int64_t us = ready_us_.load();
+        return (us >= 0 ? us : elapsed_us()) / 1e6;
+    }
+
+    // For /readyz: each stage's progress.
+    nlohmann::json status() const
+    {
+        nlohmann::json stages = nlohmann::json::object();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& stage : stages_) {
+            stages[stage->name()] = {{"done", stage->completed()}, {"total", stage->total()}, {"finished", stage->finished()},
+                                     {"seconds", stage->seconds()}};
+        }
+        return stages;
+    }
+
+private:
+    int64_t elapsed_us() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started_).count();
+    }
+
+    void stage_finished(const Stage& stage)
+    {
+        log_info("warm-up stage finished", {{"stage", stage.name()}, {"items", stage.total()}, {"elapsed_ms", stage.seconds() * 1000}});
+        check();
+    }
+
+    void check()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!sealed_ || ready_.load()) return;
+            for (const auto& stage : stages_) {
+                if (!stage->finished()) return;
+            }
+            ready_us_.store(elapsed_us());
+            ready_.store(true);
+        }
+        ready_cv_.notify_all();
+        log_info("warm-up finished", {{"elapsed_ms", elapsed_seconds() * 1000}});
+    }
+
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::vector<std::shared_ptr<Stage>> stages_;
+    bool sealed_ = false;
+    std::atomic<bool> ready_{false};
+    std::atomic<int64_t> ready_us_{-1};
+};
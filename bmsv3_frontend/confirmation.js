@@ -11,6 +11,11 @@ document.addEventListener('DOMContentLoaded', () => {
     const date = urlParams.get('date');
     const time = urlParams.get('time');
     const seats = urlParams.get('seats').split(',');
+    // One key per visit to this page, so pressing confirm again after a network
+    // error can never book the seats twice.
+    const idempotencyKey = (window.crypto && crypto.randomUUID)
+        ? crypto.randomUUID()
+        : `${Date.now()}-${Math.random().toString(16).slice(2)}`;
 
     // --- DOM Elements ---
     const confirmBtn = document.getElementById('confirm-booking-btn');
@@ -101,7 +106,7 @@ document.addEventListener('DOMContentLoaded', () => {
         try {
             const response = await fetch(`${serverUrl}/book-tickets`, {
                 method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
+                headers: { 'Content-Type': 'application/json', 'Idempotency-Key': idempotencyKey },
                 body: JSON.stringify({
                     showtime_id: parseInt(showtimeId),
                     user_id: parseInt(userId),
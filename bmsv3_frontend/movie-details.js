@@ -135,22 +135,44 @@ document.addEventListener('DOMContentLoaded', () =>
                 // Handle date selection
                 document.querySelector('.date-item.active').classList.remove('active');
                 dateItem.classList.add('active');
-                fetchShowtimes(dateItem.dataset.date); // Re-fetch showtimes for the new date
+                fetchShowtimes(dateItem.dataset.date); // Show showtimes for the new date (no new request)
             });
 
             datesBar.appendChild(dateItem);
         }
     };
 
-    // 3. Fetch and display showtimes for a given date
+    // 3. Fetch the whole week of showtimes once; switching dates just re-renders from it
+    let weekShowtimes = null;
+    const fetchWeekShowtimes = (startDate) =>
+    {
+        if (!weekShowtimes)
+        {
+            weekShowtimes = fetch(`${serverUrl}/showtimes/batch?movie_ids=${movieId}&start=${startDate}&days=7`)
+                .then(response =>
+                {
+                    if (!response.ok) throw new Error('Could not fetch showtimes');
+                    return response.json();
+                })
+                .catch(error =>
+                {
+                    weekShowtimes = null; // let the next date click try again
+                    throw error;
+                });
+        }
+        return weekShowtimes;
+    };
+
+    // Display showtimes for a given date
     const fetchShowtimes = async (date) => 
     {
         venueList.innerHTML = '<p>Loading showtimes...</p>'; // Show loading message
         try 
         {
-            const response = await fetch(`${serverUrl}/showtimes?movie_id=${movieId}&date=${date}`);
-            if (!response.ok) throw new Error('Could not fetch showtimes');
-            const venues = await response.json();
+            const week = await fetchWeekShowtimes(datesBar.querySelector('.date-item').dataset.date);
+            const days = week.movies[movieId] || {};
+            // Venue details are sent once per week, not once per day
+            const venues = (days[date] || []).map(day => ({ ...week.venues[day.venue_id], showtimes: day.showtimes }));
 
             venueList.innerHTML = ''; // Clear loading message
 
@@ -178,6 +200,15 @@ document.addEventListener('DOMContentLoaded', () =>
                     const selectedDate = document.querySelector('.date-item.active').dataset.date;
                     timeButton.className = 'time-btn';
                     timeButton.textContent = showtime.time;
+                    if (showtime.sold_out)
+                    {
+                        timeButton.disabled = true;
+                        timeButton.title = 'Sold out';
+                    }
+                    else
+                    {
+                        timeButton.title = `${showtime.seats_remaining} seats left (${showtime.premium_remaining} premium)`;
+                    }
 
                     // Add event listener to redirect to seats.html with parameters
                     timeButton.addEventListener('click', () => {
@@ -175,6 +175,7 @@ document.addEventListener('DOMContentLoaded', () => {
             }
             totalSeatsSoFar += sectionSeatCount;
         });
+        startSeatUpdates();
     };
 
     const fetchOccupiedSeats = async () => {
@@ -188,6 +189,40 @@ document.addEventListener('DOMContentLoaded', () => {
         }
     };
 
+    // Keep the map live: /seat-updates answers as soon as seats are booked,
+    // held or released (e.g. by a cancellation), then we ask again.
+    let watchingSeats = false;
+    const startSeatUpdates = () => {
+        if (watchingSeats) return;
+        watchingSeats = true;
+        watchSeatUpdates(null);
+    };
+    const watchSeatUpdates = async (version) => {
+        try {
+            const versionParam = version === null ? '' : `&version=${version}`;
+            const response = await fetch(`${serverUrl}/seat-updates?showtime_id=${showtimeId}${versionParam}`);
+            if (!response.ok) throw new Error('Seat updates unavailable');
+            const update = await response.json();
+            const occupied = new Set(update.occupied);
+            let lostSelection = false;
+            theaterContainer.querySelectorAll('.seat').forEach(seat => {
+                const taken = occupied.has(seat.dataset.seatId);
+                if (taken && seat.classList.contains('selected')) lostSelection = true;
+                seat.classList.toggle('occupied', taken);
+            });
+            if (lostSelection) {
+                document.querySelectorAll('.seat.selected').forEach(s => s.classList.remove('selected'));
+                selectedSeats = [];
+                checkoutBtn.classList.remove('visible');
+                alert('Someone just took one of the seats you picked. Please choose again.');
+            }
+            watchSeatUpdates(update.version);
+        } catch (error) {
+            console.error("Seat updates failed, retrying:", error);
+            setTimeout(() => watchSeatUpdates(version), 5000);
+        }
+    };
+
     // --- RE-INTEGRATED: Advanced Seat Selection Logic ---
     theaterContainer.addEventListener('click', (e) => {
         const clickedSeat = e.target;